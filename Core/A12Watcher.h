@@ -24,10 +24,9 @@ public:
 		Stream(_lastCycle, _cyclesDown);
 	}
 
-	A12StateChange UpdateVramAddress(uint16_t addr)
+	A12StateChange UpdateVramAddress(uint16_t addr, uint32_t cycle)
 	{
 		A12StateChange result = A12StateChange::None;
-		uint32_t cycle = PPU::GetFrameCycle();
 
 		if((addr & 0x1000) == 0) {
 			if(_cyclesDown == 0) {
@@ -10,13 +10,8 @@
 #include "SoundMixer.h"
 #include "MemoryManager.h"
 
-APU* APU::Instance = nullptr;
-bool APU::_apuEnabled = true;
-
 APU::APU(MemoryManager* memoryManager)
 {
-	APU::Instance = this;
-
 	_memoryManager = memoryManager;
 
 	_nesModel = NesModel::Auto;
@@ -66,21 +61,23 @@ void APU::SetNesModel(NesModel model, bool forceInit)
 
 void APU::FrameCounterTick(FrameType type)
 {
+	APU* apu = GetInstance();
+
 	//Quarter & half frame clock envelope & linear counter
-	Instance->_squareChannel[0]->TickEnvelope();
-	Instance->_squareChannel[1]->TickEnvelope();
-	Instance->_triangleChannel->TickLinearCounter();
-	Instance->_noiseChannel->TickEnvelope();
+	apu->_squareChannel[0]->TickEnvelope();
+	apu->_squareChannel[1]->TickEnvelope();
+	apu->_triangleChannel->TickLinearCounter();
+	apu->_noiseChannel->TickEnvelope();
 
 	if(type == FrameType::HalfFrame) {
 		//Half frames clock length counter & sweep
-		Instance->_squareChannel[0]->TickLengthCounter();
-		Instance->_squareChannel[1]->TickLengthCounter();
-		Instance->_triangleChannel->TickLengthCounter();
-		Instance->_noiseChannel->TickLengthCounter();
+		apu->_squareChannel[0]->TickLengthCounter();
+		apu->_squareChannel[1]->TickLengthCounter();
+		apu->_triangleChannel->TickLengthCounter();
+		apu->_noiseChannel->TickLengthCounter();
 
-		Instance->_squareChannel[0]->TickSweep();
-		Instance->_squareChannel[1]->TickSweep();
+		apu->_squareChannel[0]->TickSweep();
+		apu->_squareChannel[1]->TickSweep();
 	}
 }
 
@@ -155,12 +152,17 @@ void APU::Run()
 
 void APU::StaticRun()
 {
-	Instance->Run();
+	GetInstance()->Run();
 }
 
 bool APU::NeedToRun(uint32_t currentCycle)
 {
-	if(ApuLengthCounter::NeedToRun()) {
+	//Check (and clear) the flag of every length counter
+	bool lengthCounterNeedToRun = _squareChannel[0]->NeedToRun();
+	lengthCounterNeedToRun |= _squareChannel[1]->NeedToRun();
+	lengthCounterNeedToRun |= _triangleChannel->NeedToRun();
+	lengthCounterNeedToRun |= _noiseChannel->NeedToRun();
+	if(lengthCounterNeedToRun) {
 		return true;
 	}
 
@@ -188,6 +190,47 @@ void APU::Exec()
 	}
 }
 
+uint32_t APU::GetIdleCycles()
+{
+	if(!_apuEnabled) {
+		return UINT32_MAX;
+	}
+	if(EmulationSettings::GetOverclockRate() != 100 && EmulationSettings::GetOverclockAdjustApu()) {
+		return 0;
+	}
+
+	if(_squareChannel[0]->PeekNeedToRun() || _squareChannel[1]->PeekNeedToRun() || _triangleChannel->PeekNeedToRun() ||
+		_noiseChannel->PeekNeedToRun() || _deltaModulationChannel->NeedToRun()) {
+		return 0;
+	}
+
+	//Running the frame counter at the end of an audio frame doesn't change how many cycles are left before its next step
+	uint32_t cyclesToRun = _currentCycle - _previousCycle;
+	uint32_t cycles = _frameCounter->GetIdleCycles(cyclesToRun);
+	if(_deltaModulationChannel->IrqPending(cyclesToRun + cycles)) {
+		return 0;
+	}
+	return cycles;
+}
+
+void APU::SkipIdleCycles(uint32_t cycles)
+{
+	if(!_apuEnabled) {
+		return;
+	}
+
+	while(cycles > 0) {
+		uint32_t cyclesToEndFrame = SoundMixer::CycleLength - 1 - _currentCycle;
+		if(cycles < cyclesToEndFrame) {
+			_currentCycle += cycles;
+			break;
+		}
+		_currentCycle += cyclesToEndFrame - 1;
+		Exec();
+		cycles -= cyclesToEndFrame;
+	}
+}
+
 void APU::EndFrame()
 {
 	Run();
@@ -239,12 +282,13 @@ void APU::StreamState(bool saving)
 
 void APU::AddExpansionAudioDelta(AudioChannel channel, int16_t delta)
 {
-	Instance->_mixer->AddDelta(channel, Instance->_currentCycle, delta);
+	APU* apu = GetInstance();
+	apu->_mixer->AddDelta(channel, apu->_currentCycle, delta);
 }
 
 void APU::SetApuStatus(bool enabled)
 {
-	_apuEnabled = enabled;
+	GetInstance()->_apuEnabled = enabled;
 }
 
 bool APU::IsApuEnabled()
@@ -253,7 +297,7 @@ bool APU::IsApuEnabled()
 	//This appears to result in less side-effects than spreading out the APU's
 	//load over the entire PPU frame, like what was done before.
 	//This is most likely due to the timing of the Frame Counter & DMC IRQs.
-	return _apuEnabled;
+	return GetInstance()->_apuEnabled;
 }
 
 ApuState APU::GetState()
@@ -5,6 +5,7 @@
 #include "IAudioDevice.h"
 #include "Snapshotable.h"
 #include "EmulationSettings.h"
+#include "Console.h"
 
 class MemoryManager;
 class SquareChannel;
@@ -19,8 +20,7 @@ enum class NesModel;
 class APU : public Snapshotable, public IMemoryHandler
 {
 	private:
-		static APU* Instance;
-		static bool _apuEnabled;
+		bool _apuEnabled;
 
 		uint32_t _previousCycle;
 		uint32_t _currentCycle;
@@ -44,6 +44,7 @@ class APU : public Snapshotable, public IMemoryHandler
 		__forceinline bool NeedToRun(uint32_t currentCycle);
 		void Run();
 
+		static APU* GetInstance() { return Console::GetCurrent()->GetApu(); }
 		static void FrameCounterTick(FrameType type);
 
 	protected:
@@ -66,24 +67,33 @@ class APU : public Snapshotable, public IMemoryHandler
 
 		void Exec();
 
-		__forceinline static void ExecStatic()
+		//Runs the APU for one CPU cycle (called by the CPU)
+		__forceinline void ProcessCpuClock()
 		{
-			if(APU::_apuEnabled) {
+			if(_apuEnabled) {
 				if(EmulationSettings::GetOverclockRate() == 100 || !EmulationSettings::GetOverclockAdjustApu()) {
-					Instance->Exec();
+					Exec();
 				} else {
-					Instance->_cyclesNeeded += 1.0 / ((double)EmulationSettings::GetOverclockRate() / 100.0);
-					while(Instance->_cyclesNeeded >= 1.0) {
-						Instance->Exec();
-						Instance->_cyclesNeeded--;
+					_cyclesNeeded += 1.0 / ((double)EmulationSettings::GetOverclockRate() / 100.0);
+					while(_cyclesNeeded >= 1.0) {
+						Exec();
+						_cyclesNeeded--;
 					}
 				}
 			}
 		}
 
+		//Number of CPU cycles ProcessCpuClock can be called for with nothing happening but the end of an audio frame (used
+		//to skip idle loops, see CPU::SkipIdleLoop)
+		uint32_t GetIdleCycles();
+		//Same as calling ProcessCpuClock the given number of times, which must be at most GetIdleCycles()
+		void SkipIdleCycles(uint32_t cycles);
+
 		static void StaticRun();
 
 		static void AddExpansionAudioDelta(AudioChannel channel, int16_t delta);
 		static void SetApuStatus(bool enabled);
 		static bool IsApuEnabled();
+
+		friend class DeltaModulationChannel;
 };
\ No newline at end of file
@@ -185,6 +185,20 @@ public:
 		return false;
 	}
 
+	//How many more CPU cycles can be run (on top of cyclesToRun) before IrqPending returns true
+	int32_t GetIdleCycles(int32_t cyclesToRun)
+	{
+		if(_newValue >= 0 || _blockFrameCounterTick > 0) {
+			return 0;
+		}
+
+		int32_t nextEvent = _stepCycles[_stepMode][_currentStep];
+		if(_nextIrqCycle != -1) {
+			nextEvent = std::min(nextEvent, _nextIrqCycle);
+		}
+		return std::max(nextEvent - _previousCycle - cyclesToRun - 1, 0);
+	}
+
 	void GetMemoryRanges(MemoryRanges &ranges) override
 	{
 		ranges.AddHandler(MemoryOperation::Write, 0x4017);
@@ -1,4 +1,2 @@
 #include "stdafx.h"
 #include "ApuLengthCounter.h"
-
-bool ApuLengthCounter::_needToRun = false;
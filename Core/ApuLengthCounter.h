@@ -7,7 +7,7 @@ class ApuLengthCounter : public BaseApuChannel
 private:
 	uint8_t _lcLookupTable[32] = { 10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14, 12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30 };
 	bool _newHaltValue;
-	static bool _needToRun;
+	bool _needToRun = false;
 
 protected:
 	bool _enabled = false;
@@ -33,7 +33,7 @@ protected:
 
 	void SetRunFlag()
 	{
-		ApuLengthCounter::_needToRun = true;
+		_needToRun = true;
 	}
 
 public:
@@ -41,13 +41,19 @@ public:
 	{
 	}
 	
-	static bool NeedToRun()
+	bool NeedToRun()
 	{
-		bool needToRun = ApuLengthCounter::_needToRun;
-		ApuLengthCounter::_needToRun = false;
+		bool needToRun = _needToRun;
+		_needToRun = false;
 		return needToRun;
 	}
 
+	//Same as NeedToRun, without clearing the flag
+	bool PeekNeedToRun()
+	{
+		return _needToRun;
+	}
+
 	virtual void Reset(bool softReset) override
 	{
 		BaseApuChannel::Reset(softReset);
@@ -71,7 +77,7 @@ public:
 			_lengthCounterPreviousValue = 0;		
 		}		
 
-		ApuLengthCounter::_needToRun = false;
+		_needToRun = false;
 	}
 
 	virtual void StreamState(bool saving) override
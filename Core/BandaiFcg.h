@@ -49,6 +49,8 @@ protected:
 		Stream(_irqEnabled, _irqCounter, _irqReload, _prgPage, _prgBankSelect, chrRegs);
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqEnabled) {
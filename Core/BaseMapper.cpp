@@ -3,6 +3,7 @@
 #include <assert.h>
 #include "../Utilities/FolderUtilities.h"
 #include "../Utilities/IpsPatcher.h"
+#include "../Utilities/CRC32.h"
 #include "BaseMapper.h"
 #include "Console.h"
 #include "CheatManager.h"
@@ -14,6 +15,88 @@ uint8_t BaseMapper::ReadRegister(uint16_t addr) { return 0; }
 void BaseMapper::InitMapper(RomData &romData) { }
 void BaseMapper::Reset(bool softReset) { }
 
+SimpleLock BaseMapper::_romImageLock;
+std::unordered_multimap<uint32_t, std::weak_ptr<vector<uint8_t>>> BaseMapper::_romImages;
+
+shared_ptr<vector<uint8_t>> BaseMapper::GetSharedRomImage(vector<uint8_t> &data)
+{
+	uint32_t crc = CRC32::GetCRC(data.data(), data.size());
+
+	auto lock = _romImageLock.AcquireSafe();
+	auto range = _romImages.equal_range(crc);
+	for(auto it = range.first; it != range.second;) {
+		shared_ptr<vector<uint8_t>> image = it->second.lock();
+		if(!image) {
+			//No console is using this image anymore
+			it = _romImages.erase(it);
+		} else if(*image == data) {
+			return image;
+		} else {
+			it++;
+		}
+	}
+
+	shared_ptr<vector<uint8_t>> image(new vector<uint8_t>(data));
+	_romImages.emplace(crc, image);
+	return image;
+}
+
+void BaseMapper::DetachPrgRom()
+{
+	if(!_ownsPrgRom) {
+		uint8_t* sharedRom = _prgRom;
+		_prgRom = new uint8_t[_prgSize];
+		memcpy(_prgRom, sharedRom, _prgSize);
+		_ownsPrgRom = true;
+		RebaseRomPointers(sharedRom, _prgSize, _prgRom);
+	}
+}
+
+void BaseMapper::DetachChrRom()
+{
+	if(!_ownsChrRom) {
+		uint32_t size = (uint32_t)_originalChrRom->size();
+		uint8_t* sharedRom = _chrRom;
+		_chrRom = new uint8_t[size];
+		memcpy(_chrRom, sharedRom, size);
+		_ownsChrRom = true;
+		RebaseRomPointers(sharedRom, size, _chrRom);
+	}
+}
+
+void BaseMapper::RebaseRomPointers(uint8_t* oldBase, uint32_t size, uint8_t* newBase)
+{
+	auto rebase = [=](uint8_t* &ptr) {
+		if(ptr >= oldBase && ptr < oldBase + size) {
+			ptr = newBase + (ptr - oldBase);
+		}
+	};
+
+	for(int i = 0; i <= 0xFF; i++) {
+		rebase(_prgPages[i]);
+		rebase(_chrPages[i]);
+	}
+	for(int i = 0; i < 10; i++) {
+		rebase(_cartNametableRam[i]);
+	}
+	UpdatePrgReadPages(0, 0xFF);
+}
+
+uint8_t* BaseMapper::GetWritableRomPointer(uint8_t* source)
+{
+	//Switch to a private copy of the ROM before allowing anything to write to it
+	if(source && !_ownsPrgRom && source >= _prgRom && source < _prgRom + _prgSize) {
+		uint32_t offset = (uint32_t)(source - _prgRom);
+		DetachPrgRom();
+		return _prgRom + offset;
+	} else if(source && !_ownsChrRom && source >= _chrRom && source < _chrRom + _originalChrRom->size()) {
+		uint32_t offset = (uint32_t)(source - _chrRom);
+		DetachChrRom();
+		return _chrRom + offset;
+	}
+	return source;
+}
+
 //Make sure the page size is no bigger than the size of the ROM itself
 //Otherwise we will end up reading from unallocated memory
 uint16_t BaseMapper::InternalGetPrgPageSize() { return std::min((uint32_t)GetPRGPageSize(), _prgSize); }
@@ -119,6 +202,10 @@ void BaseMapper::SetCpuMemoryMapping(uint16_t startAddr, uint16_t endAddr, uint8
 	}
 	#endif
 
+	if(accessType != -1 && (accessType & MemoryAccessType::Write)) {
+		source = GetWritableRomPointer(source);
+	}
+
 	startAddr >>= 8;
 	endAddr >>= 8;
 	for(uint16_t i = startAddr; i <= endAddr; i++) {
@@ -127,6 +214,7 @@ void BaseMapper::SetCpuMemoryMapping(uint16_t startAddr, uint16_t endAddr, uint8
 
 		source += 0x100;
 	}
+	UpdatePrgReadPages(startAddr, endAddr);
 }
 
 void BaseMapper::RemoveCpuMemoryMapping(uint16_t startAddr, uint16_t endAddr)
@@ -220,6 +308,10 @@ void BaseMapper::SetPpuMemoryMapping(uint16_t startAddr, uint16_t endAddr, uint8
 	}
 	#endif
 
+	if(accessType == -1 || (accessType & MemoryAccessType::Write)) {
+		sourceMemory = GetWritableRomPointer(sourceMemory);
+	}
+
 	startAddr >>= 8;
 	endAddr >>= 8;
 	for(uint16_t i = startAddr; i <= endAddr; i++) {
@@ -243,6 +335,18 @@ uint8_t BaseMapper::InternalReadRam(uint16_t addr)
 	return _prgPages[addr >> 8] ? _prgPages[addr >> 8][(uint8_t)addr] : 0;
 }
 
+void BaseMapper::UpdateHookFlags()
+{
+	_hasCpuClockHook = _forceHooks || EnableCpuClockHook();
+	_hasVramAddressHook = _forceHooks || EnableVramAddressHook();
+}
+
+void BaseMapper::SetForceHooks(bool force)
+{
+	_forceHooks = force;
+	UpdateHookFlags();
+}
+
 void BaseMapper::SelectPrgPage4x(uint16_t slot, uint16_t page, PrgMemoryType memoryType)
 {
 	BaseMapper::SelectPrgPage2x(slot*2, page, memoryType);
@@ -392,7 +496,9 @@ string BaseMapper::GetBatteryFilename()
 		
 void BaseMapper::RestoreOriginalPrgRam()
 {
-	memcpy(_prgRom, _originalPrgRom.data(), _originalPrgRom.size());
+	if(_ownsPrgRom) {
+		memcpy(_prgRom, _originalPrgRom->data(), _originalPrgRom->size());
+	}
 }
 
 void BaseMapper::InitializeChrRam(int32_t chrRamSize)
@@ -425,6 +531,7 @@ void BaseMapper::AddRegisterRange(uint16_t startAddr, uint16_t endAddr, MemoryOp
 			_isWriteRegisterAddr[i] = true;
 		}
 	}
+	UpdateDirectReadPages(startAddr >> 8, endAddr >> 8);
 }
 
 void BaseMapper::RemoveRegisterRange(uint16_t startAddr, uint16_t endAddr, MemoryOperation operation)
@@ -437,6 +544,41 @@ void BaseMapper::RemoveRegisterRange(uint16_t startAddr, uint16_t endAddr, Memor
 			_isWriteRegisterAddr[i] = false;
 		}
 	}
+	UpdateDirectReadPages(startAddr >> 8, endAddr >> 8);
+}
+
+void BaseMapper::SetOwnsCpuReadPage(uint8_t page, bool owned)
+{
+	if(_ownsCpuReadPage[page] != owned) {
+		_ownsCpuReadPage[page] = owned;
+		UpdateDirectReadPages(page, page);
+	}
+}
+
+void BaseMapper::UpdateDirectReadPages(uint16_t startPage, uint16_t endPage)
+{
+	for(uint16_t i = startPage; i <= endPage; i++) {
+		bool directRead = _allowDirectPrgReads && _ownsCpuReadPage[i];
+		if(directRead && _allowRegisterRead) {
+			for(int j = 0; j <= 0xFF; j++) {
+				if(_isReadRegisterAddr[(i << 8) | j]) {
+					directRead = false;
+					break;
+				}
+			}
+		}
+		_isDirectReadPage[i] = directRead;
+	}
+	UpdatePrgReadPages(startPage, endPage);
+}
+
+void BaseMapper::UpdatePrgReadPages(uint16_t startPage, uint16_t endPage)
+{
+	for(uint16_t i = startPage; i <= endPage; i++) {
+		_prgReadPages[i] = _isDirectReadPage[i] && (_prgPageAccessType[i] & MemoryAccessType::Read) ? _prgPages[i] : nullptr;
+		bool sharedRomPage = _prgReadPages[i] && !_ownsPrgRom && _prgReadPages[i] >= _prgRom && _prgReadPages[i] < _prgRom + _prgSize && ((_prgReadPages[i] - _prgRom) & 0xFF) == 0;
+		_prgRomReadOffsets[i] = sharedRomPage ? (int32_t)(_prgReadPages[i] - _prgRom) : -1;
+	}
 }
 
 void BaseMapper::StreamState(bool saving)
@@ -498,6 +640,12 @@ void BaseMapper::Initialize(RomData &romData)
 	}
 
 	_allowRegisterRead = AllowRegisterRead();
+	UpdateHookFlags();
+	_allowDirectPrgReads = AllowDirectPrgReads();
+	memset(_ownsCpuReadPage, 0, sizeof(_ownsCpuReadPage));
+	memset(_isDirectReadPage, 0, sizeof(_isDirectReadPage));
+	memset(_prgReadPages, 0, sizeof(_prgReadPages));
+	memset(_prgRomReadOffsets, 0xFF, sizeof(_prgRomReadOffsets));
 
 	memset(_isReadRegisterAddr, 0, sizeof(_isReadRegisterAddr));
 	memset(_isWriteRegisterAddr, 0, sizeof(_isWriteRegisterAddr));
@@ -510,15 +658,11 @@ void BaseMapper::Initialize(RomData &romData)
 
 	_prgSize = (uint32_t)romData.PrgRom.size();
 	_chrRomSize = (uint32_t)romData.ChrRom.size();
-	_originalPrgRom = romData.PrgRom;
-	_originalChrRom = romData.ChrRom;
+	_originalPrgRom = GetSharedRomImage(romData.PrgRom);
+	_originalChrRom = GetSharedRomImage(romData.ChrRom);
 
-	_prgRom = new uint8_t[_prgSize];
-	_chrRom = new uint8_t[_chrRomSize];
-	memcpy(_prgRom, romData.PrgRom.data(), _prgSize);
-	if(_chrRomSize > 0) {
-		memcpy(_chrRom, romData.ChrRom.data(), _chrRomSize);
-	}
+	_prgRom = _originalPrgRom->data();
+	_chrRom = _originalChrRom->data();
 
 	_hasChrBattery = romData.SaveChrRamSize > 0 || ForceChrBattery();
 
@@ -596,8 +740,12 @@ void BaseMapper::Initialize(RomData &romData)
 BaseMapper::~BaseMapper()
 {
 	delete[] _chrRam;
-	delete[] _chrRom;
-	delete[] _prgRom;
+	if(_ownsChrRom) {
+		delete[] _chrRom;
+	}
+	if(_ownsPrgRom) {
+		delete[] _prgRom;
+	}
 	delete[] _saveRam;
 	delete[] _workRam;
 
@@ -617,7 +765,10 @@ void BaseMapper::ProcessNotification(ConsoleNotificationType type, void* paramet
 	switch(type) {
 		case ConsoleNotificationType::CheatAdded:
 		case ConsoleNotificationType::CheatRemoved:
-			ApplyCheats();
+			//Notifications are sent to every mapper, only react to changes made to this mapper's console
+			if(Console::GetCurrent()->GetMapper() == this) {
+				ApplyCheats();
+			}
 			break;
 		default:
 			break;
@@ -628,7 +779,10 @@ void BaseMapper::ProcessNotification(ConsoleNotificationType type, void* paramet
 void BaseMapper::ApplyCheats()
 {
 	RestoreOriginalPrgRam();
-	CheatManager::ApplyPrgCodes(_prgRom, _prgSize);
+	if(CheatManager::HasPrgCodes()) {
+		DetachPrgRom();
+		CheatManager::ApplyPrgCodes(_prgRom, _prgSize);
+	}
 }
 
 void BaseMapper::GetMemoryRanges(MemoryRanges &ranges)
@@ -816,16 +970,19 @@ uint8_t BaseMapper::MapperReadVRAM(uint16_t addr, MemoryOperationType operationT
 
 void BaseMapper::InternalWriteVRAM(uint16_t addr, uint8_t value)
 {
-	if(_chrPages[addr >> 8]) {
-		_chrPages[addr >> 8][(uint8_t)addr] = value;
+	uint8_t* page = GetWritableRomPointer(_chrPages[addr >> 8]);
+	if(page) {
+		page[(uint8_t)addr] = value;
 	}
 }
 
 void BaseMapper::WriteVRAM(uint16_t addr, uint8_t value)
 {
 	ProcessVramAccess(addr);
-	Debugger::ProcessVramWriteOperation(addr, value);
-	NotifyVRAMAddressChange(addr);
+	Debugger::ProcessVramWriteOperation(_console->GetAttachedDebugger(), addr, value);
+	if(_hasVramAddressHook) {
+		NotifyVRAMAddressChange(addr);
+	}
 
 	if(_chrPageAccessType[addr >> 8] & MemoryAccessType::Write) {
 		_chrPages[addr >> 8][(uint8_t)addr] = value;
@@ -840,6 +997,8 @@ bool BaseMapper::IsNes20()
 //Debugger Helper Functions
 uint8_t* BaseMapper::GetPrgRom()
 {
+	//The caller may keep this pointer and use it to edit the ROM
+	DetachPrgRom();
 	return _prgRom;
 }
 
@@ -904,10 +1063,10 @@ uint8_t BaseMapper::GetMemoryValue(DebugMemoryType memoryType, uint32_t address)
 void BaseMapper::SetMemoryValue(DebugMemoryType memoryType, uint32_t address, uint8_t value)
 {
 	switch(memoryType) {
-		case DebugMemoryType::ChrRom: _chrRom[address] = value; break;
+		case DebugMemoryType::ChrRom: DetachChrRom(); _chrRom[address] = value; break;
 		case DebugMemoryType::ChrRam: _chrRam[address] = value; break;
 		case DebugMemoryType::SaveRam: _saveRam[address] = value; break;
-		case DebugMemoryType::PrgRom: _prgRom[address] = value; break;
+		case DebugMemoryType::PrgRom: DetachPrgRom(); _prgRom[address] = value; break;
 		case DebugMemoryType::WorkRam: _workRam[address] = value; break;
 	}
 }
@@ -1049,21 +1208,21 @@ void BaseMapper::SaveRomToDisk(string filename, bool saveAsIps, uint8_t* header)
 
 void BaseMapper::RevertPrgChrChanges()
 {
-	memcpy(_prgRom, _originalPrgRom.data(), _originalPrgRom.size());
-	if(_chrRom) {
-		memcpy(_chrRom, _originalChrRom.data(), _originalChrRom.size());
+	if(_ownsPrgRom) {
+		memcpy(_prgRom, _originalPrgRom->data(), _originalPrgRom->size());
+	}
+	if(_ownsChrRom) {
+		memcpy(_chrRom, _originalChrRom->data(), _originalChrRom->size());
 	}
 }
 
 bool BaseMapper::HasPrgChrChanges()
 {
-	if(memcmp(_prgRom, _originalPrgRom.data(), _originalPrgRom.size()) != 0) {
+	if(_ownsPrgRom && memcmp(_prgRom, _originalPrgRom->data(), _originalPrgRom->size()) != 0) {
 		return true;
 	}
-	if(_chrRom) {
-		if(memcmp(_chrRom, _originalChrRom.data(), _originalChrRom.size()) != 0) {
-			return true;
-		}
+	if(_ownsChrRom && memcmp(_chrRom, _originalChrRom->data(), _originalChrRom->size()) != 0) {
+		return true;
 	}
 	return false;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stdafx.h"
+#include <unordered_map>
 #include "Snapshotable.h"
 #include "IMemoryHandler.h"
 #include "MessageManager.h"
@@ -8,7 +9,9 @@
 #include "EmulationSettings.h"
 #include "DebuggerTypes.h"
 #include "Debugger.h"
+#include "Console.h"
 #include "Types.h"
+#include "../Utilities/SimpleLock.h"
 
 class BaseMapper : public IMemoryHandler, public Snapshotable, public INotificationListener
 {
@@ -28,6 +31,10 @@ private:
 
 	bool _onlyChrRam = false;
 	bool _hasBusConflicts = false;
+
+	bool _hasCpuClockHook = false;
+	bool _hasVramAddressHook = false;
+	bool _forceHooks = false;
 	
 	string _romFilename;
 	string _romName;
@@ -42,15 +49,40 @@ private:
 	uint8_t _prgPageAccessType[0x100];
 	uint8_t _chrPageAccessType[0x100];
 
+	//Pages whose CPU reads can skip ReadRAM (every read goes to this mapper, no readable registers)
+	bool _allowDirectPrgReads = true;
+	bool _ownsCpuReadPage[0x100];
+	bool _isDirectReadPage[0x100];
+	//Same as _prgPages for readable direct read pages, nullptr otherwise - used by MemoryManager::Read
+	uint8_t* _prgReadPages[0x100];
+	//Offset in the PRG ROM of each page in _prgReadPages, as long as the ROM is the shared image (which can't change) and the
+	//page starts on a 256-byte boundary of the ROM, -1 otherwise
+	int32_t _prgRomReadOffsets[0x100];
+
 	uint32_t _prgPageNumbers[64];
 	uint32_t _chrPageNumbers[64];
 
 	HashInfo _hashInfo;
 
-	vector<uint8_t> _originalPrgRom;
-	vector<uint8_t> _originalChrRom;
+	//Unmodified PRG/CHR ROM images - these are shared between all consoles that loaded the same ROM.
+	//_prgRom/_chrRom point directly into them until the mapper needs to write to its ROM (cheats, writable mappings, debugger edits),
+	//at which point the mapper switches to its own private copy.
+	shared_ptr<vector<uint8_t>> _originalPrgRom;
+	shared_ptr<vector<uint8_t>> _originalChrRom;
+	bool _ownsPrgRom = false;
+	bool _ownsChrRom = false;
+
+	static SimpleLock _romImageLock;
+	static std::unordered_multimap<uint32_t, std::weak_ptr<vector<uint8_t>>> _romImages;
+
+	static shared_ptr<vector<uint8_t>> GetSharedRomImage(vector<uint8_t> &data);
+	void DetachPrgRom();
+	void DetachChrRom();
+	void RebaseRomPointers(uint8_t* oldBase, uint32_t size, uint8_t* newBase);
+	uint8_t* GetWritableRomPointer(uint8_t* source);
 
 protected:
+	Console* _console = nullptr;
 	NESHeader _nesHeader;
 	GameInfo _databaseInfo;
 
@@ -100,10 +132,19 @@ protected:
 	virtual uint16_t RegisterStartAddress() { return 0x8000; }
 	virtual uint16_t RegisterEndAddress() { return 0xFFFF; }
 	virtual bool AllowRegisterRead() { return false; }
+	//Mappers that override ReadRAM to watch PRG reads must return false
+	virtual bool AllowDirectPrgReads() { return true; }
 
 	virtual bool HasBusConflicts() { return false; }
 
+	//ProcessCpuClock/NotifyVRAMAddressChange are only called for mappers that enable them
+	virtual bool EnableCpuClockHook() { return false; }
+	virtual bool EnableVramAddressHook() { return false; }
+
 	uint8_t InternalReadRam(uint16_t addr);
+	void UpdateHookFlags();
+	void UpdateDirectReadPages(uint16_t startPage, uint16_t endPage);
+	void UpdatePrgReadPages(uint16_t startPage, uint16_t endPage);
 
 	virtual void WriteRegister(uint16_t addr, uint8_t value);
 	virtual uint8_t ReadRegister(uint16_t addr);
@@ -147,12 +188,21 @@ protected:
 
 public:
 	void Initialize(RomData &romData);
+	void SetConsole(Console* console) { _console = console; }
 
 	virtual ~BaseMapper();
 	virtual void Reset(bool softReset);
 
 	virtual void SetNesModel(NesModel model) { }
 	virtual void ProcessCpuClock() { }
+	bool HasCpuClockHook() { return _hasCpuClockHook; }
+	bool HasVramAddressHook() { return _hasVramAddressHook; }
+	//Used by benchmarks: calls the hooks even if the mapper doesn't enable them (see Console::SetForceMapperHooks)
+	void SetForceHooks(bool force);
+	uint16_t GetMapperId() { return _mapperID; }
+	//Mappers that trigger IRQs based on the PPU's bus activity need the PPU to run in lockstep with the CPU (at least while
+	//those IRQs are enabled - it is checked again after every write to the mapper's registers)
+	virtual bool RequiresPpuSync() { return false; }
 	virtual void NotifyVRAMAddressChange(uint16_t addr);
 	void ProcessNotification(ConsoleNotificationType type, void* parameter) override; 
 	virtual void GetMemoryRanges(MemoryRanges &ranges) override;
@@ -173,16 +223,22 @@ public:
 	void DebugWriteRAM(uint16_t addr, uint8_t value);
 	void WritePrgRam(uint16_t addr, uint8_t value);
 
+	void SetOwnsCpuReadPage(uint8_t page, bool owned);
+	uint8_t** GetPrgReadPages() { return _prgReadPages; }
+	int32_t* GetPrgRomReadOffsets() { return _prgRomReadOffsets; }
+
 	__forceinline uint8_t InternalReadVRAM(uint16_t addr);
 	__forceinline virtual uint8_t MapperReadVRAM(uint16_t addr, MemoryOperationType operationType);
 	
 	__forceinline uint8_t ReadVRAM(uint16_t addr, MemoryOperationType type = MemoryOperationType::PpuRenderingRead) 
 	{
 		ProcessVramAccess(addr);
-		NotifyVRAMAddressChange(addr);
+		if(_hasVramAddressHook) {
+			NotifyVRAMAddressChange(addr);
+		}
 
 		uint8_t value = MapperReadVRAM(addr, type);
-		Debugger::ProcessVramReadOperation(type, addr, value);
+		Debugger::ProcessVramReadOperation(_console->GetAttachedDebugger(), type, addr, value);
 		return value;
 	}
 
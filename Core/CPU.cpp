@@ -8,12 +8,8 @@
 #include "NsfMapper.h"
 #include "MemoryManager.h"
 
-CPU* CPU::Instance = nullptr;
-
 CPU::CPU(MemoryManager *memoryManager)
 {
-	CPU::Instance = this;
-
 	Func opTable[] = { 
 	//	0				1				2				3				4				5				6						7				8				9				A						B				C						D				E						F
 		&CPU::BRK,	&CPU::ORA,	&CPU::HLT,	&CPU::SLO,	&CPU::NOP,	&CPU::ORA,	&CPU::ASL_Memory,	&CPU::SLO,	&CPU::PHP,	&CPU::ORA,	&CPU::ASL_Acc,		&CPU::AAC,	&CPU::NOP,			&CPU::ORA,	&CPU::ASL_Memory,	&CPU::SLO, //0
@@ -90,6 +86,11 @@ void CPU::Reset(bool softReset, NesModel model)
 	//Used by NSF code to disable Frame Counter & DMC interrupts
 	_irqMask = 0xFF;
 
+	_ppuCatchUp = false;
+	_ppuPendingCycles = 0;
+	_ppuSyncCountdown = 0;
+	_idleLoopJump = false;
+
 	//Use _memoryManager->Read() directly to prevent clocking the PPU/APU when setting PC at reset
 	_state.PC = _memoryManager->Read(CPU::ResetVector) | _memoryManager->Read(CPU::ResetVector+1) << 8;
 
@@ -108,26 +109,522 @@ void CPU::Reset(bool softReset, NesModel model)
 
 	//The CPU takes some cycles before starting its execution after a reset/power up
 	for(int i = 0; i < (model == NesModel::NTSC ? 28 : 30); i++) {
-		PPU::RunOneCycle();
+		_ppu->Exec();
 	}
 
 	for(int i = 0; i < 10; i++) {
-		APU::ExecStatic();
+		_apu->ProcessCpuClock();
 	}
 }
 
 void CPU::Exec()
 {
-	uint8_t opCode = GetOPCode();
-	_instAddrMode = _addrMode[opCode];
-	_operand = FetchOperand();
-	(this->*_opTable[opCode])();
+	if(_idleLoopJump) {
+		_idleLoopJump = false;
+		SkipIdleLoop(_state.DebugPC);
+	}
+
+	if(!EmulationSettings::CheckFlag(EmulationFlags::PrgDecodeCache) || !ExecDecoded()) {
+		uint8_t opCode = GetOPCode();
+		if(EmulationSettings::CheckFlag(EmulationFlags::FusedCpuCore)) {
+			ExecFused(opCode);
+		} else {
+			_instAddrMode = _addrMode[opCode];
+			_operand = FetchOperand();
+			(this->*_opTable[opCode])();
+		}
+	}
 	
 	if(_prevRunIrq) {
 		IRQ();
+	} else if((uint16_t)(_state.DebugPC - _state.PC) <= 3 && EmulationSettings::CheckFlag(EmulationFlags::SkipIdleLoops)) {
+		//Jumped back to itself or to the instruction just before it - only checked at the start of the next instruction, once
+		//the console has seen the frame that might have ended during this one
+		_idleLoopJump = true;
+	}
+}
+
+//Runs the instruction at PC from _decodeCache, decoding it there first if needed: the opcode and operand bytes are not read
+//from the mapper again, but their cycles, DMC stalls and open bus value are the same as for regular reads (the dummy reads and
+//the instruction's own reads still go through MemoryRead).  The cache is keyed by PRG ROM offset and only used while the
+//ROM is the shared image, which nothing can write to (cheats, the debugger and flash-writable mappers detach it first), and
+//while the CPU bus is plain (no CPU clock hook could switch banks during the instruction), so it never has to be invalidated.
+//Returns false, without running anything, when the instruction can't come from the cache.
+bool CPU::ExecDecoded()
+{
+	int32_t offset = _memoryManager->GetPrgRomReadOffset(_state.PC);
+	if(offset < 0 || !_memoryManager->IsPlainCpuBus()) {
+		return false;
+	}
+
+	if(_decodeCache.empty()) {
+		_decodeCache.resize(_memoryManager->GetPrgRomSize());
+	}
+
+	DecodedInstruction &inst = _decodeCache[offset];
+	if(inst.Size == 0) {
+		//Instruction length for each AddrMode, 0 for None (invalid opcodes)
+		static const uint8_t instSize[] = { 0, 1, 1, 2, 2, 2, 3, 2, 2, 3, 2, 2, 2, 3, 3, 3, 3 };
+
+		inst.OpCode = _memoryManager->PeekPlain(_state.PC);
+		inst.Mode = _addrMode[inst.OpCode];
+		uint8_t size = instSize[(int)inst.Mode];
+		if(size == 0 || (_state.PC & 0xFF) + size > 0x100) {
+			//The operand bytes would be on the next page, which can map any part of the ROM
+			inst.Size = DecodedInstruction::Uncacheable;
+		} else {
+			for(int i = 1; i < size; i++) {
+				inst.Operand[i - 1] = _memoryManager->PeekPlain(_state.PC + i);
+			}
+			inst.Size = size;
+		}
+	}
+
+	if(inst.Size == DecodedInstruction::Uncacheable) {
+		return false;
+	}
+
+	_state.DebugPC = _state.PC;
+	DecodedRead(inst.OpCode);
+	_state.PC++;
+
+	_decodedOperand = inst.Operand;
+	if(EmulationSettings::CheckFlag(EmulationFlags::FusedCpuCore)) {
+		//Operand bytes are only read by the addressing mode, before anything the instruction does
+		ExecFused(inst.OpCode);
+		_decodedOperand = nullptr;
+	} else {
+		_instAddrMode = inst.Mode;
+		_operand = FetchOperand();
+		_decodedOperand = nullptr;
+		(this->*_opTable[inst.OpCode])();
+	}
+	return true;
+}
+
+//Cycle of a read from the PRG ROM that returned value (no side effects other than the open bus), see ExecDecoded
+void CPU::DecodedRead(uint8_t value)
+{
+	IncCycleCount();
+	while(_dmcDmaRunning) {
+		//Same stall as in MemoryRead - the reads it does on the current address have no effect on ROM
+		IncCycleCount();
+	}
+	_memoryManager->SetLastReadValue(value);
+}
+
+//Called before the next instruction when the jump/branch at jumpAddr went back to itself or to the instruction just
+//before it.  When that loop is known to do the exact same thing on every iteration until an interrupt or the PPU setting
+//the vertical blank flag ends it (JMP *, a branch to itself, or LDA/LDX/LDY/BIT of internal RAM/ROM then a branch back,
+//or of $2002 then BPL), only its cycles are emulated for all but the last of the iterations that fit before anything the
+//PPU, APU or mapper could do: the iterations' reads would not change anything, so the result is the same as running them.
+void CPU::SkipIdleLoop(uint16_t jumpAddr)
+{
+	uint16_t loopAddr = _state.PC;
+	if(_runIrq || GetSkippableCycles() == 0) {
+		return;
+	}
+
+	//The loop's bytes, and the byte after a branch (read by its dummy read)
+	for(uint16_t i = 0, size = jumpAddr + 2 - loopAddr; i <= size; i++) {
+		if(!_memoryManager->IsPlainAddress(loopAddr + i)) {
+			return;
+		}
+	}
+
+	uint8_t jumpOpCode = _memoryManager->PeekPlain(jumpAddr);
+	bool isBranch = (jumpOpCode & 0x1F) == 0x10;
+	uint32_t loopCycles;
+	if(isBranch) {
+		//Opcode, offset, dummy read, and another dummy read when crossing a page
+		loopCycles = ((jumpAddr + 2) & 0xFF00) == (loopAddr & 0xFF00) ? 3 : 4;
+	} else if(jumpOpCode == 0x4C) {
+		//JMP absolute
+		loopCycles = 3;
+	} else {
+		return;
+	}
+
+	if(loopAddr != jumpAddr) {
+		uint8_t loadOpCode = _memoryManager->PeekPlain(loopAddr);
+		bool zeroPage;
+		switch(loadOpCode) {
+			case 0xA5: case 0xA6: case 0xA4: case 0x24: zeroPage = true; break;
+			case 0xAD: case 0xAE: case 0xAC: case 0x2C: zeroPage = false; break;
+			default: return;
+		}
+		if((uint16_t)(loopAddr + (zeroPage ? 2 : 3)) != jumpAddr) {
+			return;
+		}
+
+		uint16_t readAddr = _memoryManager->PeekPlain(loopAddr + 1);
+		if(!zeroPage) {
+			readAddr |= _memoryManager->PeekPlain(loopAddr + 2) << 8;
+		}
+		if(_memoryManager->IsPlainAddress(readAddr)) {
+			if(isBranch) {
+				//The branch has to be taken with the value the load reads now - the flags could be from before an interrupt
+				static const uint8_t branchFlags[4] = { PSFlags::Negative, PSFlags::Overflow, PSFlags::Carry, PSFlags::Zero };
+				uint8_t value = _memoryManager->PeekPlain(readAddr);
+				uint8_t flags = (_state.PS & ~(PSFlags::Negative | PSFlags::Zero)) | (value & PSFlags::Negative);
+				if((loadOpCode & 0xF0) == 0x20) {
+					//BIT
+					flags = (flags & ~PSFlags::Overflow) | (value & PSFlags::Overflow) | ((_state.A & value) ? 0 : PSFlags::Zero);
+				} else if(!value) {
+					flags |= PSFlags::Zero;
+				}
+				if(((flags & branchFlags[jumpOpCode >> 6]) != 0) != ((jumpOpCode & 0x20) != 0)) {
+					return;
+				}
+			}
+		} else {
+			//Waiting for the vertical blank flag, which can't get set before the PPU has to be synced again (but might have been
+			//since the last read), while reads only clear it and the write toggle - any other bit could change before then
+			if((readAddr & 0xE007) != 0x2002 || jumpOpCode != 0x10) {
+				return;
+			}
+			RunPendingPpuCycles();
+			if(_ppu->IsVerticalBlankFlagSet()) {
+				return;
+			}
+		}
+		loopCycles += zeroPage ? 3 : 4;
+	}
+
+	//Leave the last iteration that fits to Exec, so the loop's reads are done for real before whatever could end it
+	uint32_t iterations = GetSkippableCycles() / loopCycles;
+	if(iterations < 2) {
+		return;
 	}
+
+	uint32_t cycles = (iterations - 1) * loopCycles;
+	SkipCycles(cycles);
+	_skippedIdleCycles += cycles;
 }
 
+//Number of CPU cycles that can go by without the PPU, APU or mapper doing anything the CPU would have to see right away (the
+//PPU setting the NMI flag or starting a frame, an APU IRQ, frame counter step or DMC DMA, a CPU clock hook), 0 if unknown
+uint32_t CPU::GetSkippableCycles()
+{
+	if(!_ppuCatchUp || _dmcDmaRunning || !_memoryManager->IsPlainCpuBus()) {
+		return 0;
+	}
+	return std::min((uint32_t)std::max(_ppuSyncCountdown - 1, 0), _apu->GetIdleCycles());
+}
+
+//What IncCycleCount would do for that many cycles, at most GetSkippableCycles() - the IRQ lines stay as they are, as
+//nothing can raise them
+void CPU::SkipCycles(uint32_t cycles)
+{
+	_cycleCount += cycles;
+	_ppuPendingCycles += cycles;
+	_ppuSyncCountdown -= cycles;
+	_apu->SkipIdleCycles(cycles);
+}
+
+//Same as FetchOperand, for an addressing mode known at compile time
+#define FETCH_None FetchOperand()
+#define FETCH_Acc (DummyRead(), 0)
+#define FETCH_Imp (DummyRead(), 0)
+#define FETCH_Imm GetImmediate()
+#define FETCH_Rel GetImmediate()
+#define FETCH_Zero GetZeroAddr()
+#define FETCH_ZeroX GetZeroXAddr()
+#define FETCH_ZeroY GetZeroYAddr()
+#define FETCH_Ind GetIndAddr()
+#define FETCH_IndX GetIndXAddr()
+#define FETCH_IndY GetIndYAddr(false)
+#define FETCH_IndYW GetIndYAddr(true)
+#define FETCH_Abs GetAbsAddr()
+#define FETCH_AbsX GetAbsXAddr(false)
+#define FETCH_AbsXW GetAbsXAddr(true)
+#define FETCH_AbsY GetAbsYAddr(false)
+#define FETCH_AbsYW GetAbsYAddr(true)
+#define OP(opCode, mode, func) case opCode: _instAddrMode = AddrMode::mode; _operand = FETCH_##mode; func(); break;
+
+void CPU::ExecFused(uint8_t opCode)
+{
+	//Same opcodes/addressing modes as _opTable/_addrMode, but the operand fetch and the instruction are inlined in a
+	//single switch instead of going through FetchOperand's switch and a member function pointer
+	switch(opCode) {
+		OP(0x00, Imp, BRK)
+		OP(0x01, IndX, ORA)
+		OP(0x02, None, HLT)
+		OP(0x03, IndX, SLO)
+		OP(0x04, Zero, NOP)
+		OP(0x05, Zero, ORA)
+		OP(0x06, Zero, ASL_Memory)
+		OP(0x07, Zero, SLO)
+		OP(0x08, Imp, PHP)
+		OP(0x09, Imm, ORA)
+		OP(0x0A, Acc, ASL_Acc)
+		OP(0x0B, Imm, AAC)
+		OP(0x0C, Abs, NOP)
+		OP(0x0D, Abs, ORA)
+		OP(0x0E, Abs, ASL_Memory)
+		OP(0x0F, Abs, SLO)
+		OP(0x10, Rel, BPL)
+		OP(0x11, IndY, ORA)
+		OP(0x12, None, HLT)
+		OP(0x13, IndYW, SLO)
+		OP(0x14, ZeroX, NOP)
+		OP(0x15, ZeroX, ORA)
+		OP(0x16, ZeroX, ASL_Memory)
+		OP(0x17, ZeroX, SLO)
+		OP(0x18, Imp, CLC)
+		OP(0x19, AbsY, ORA)
+		OP(0x1A, Imp, NOP)
+		OP(0x1B, AbsYW, SLO)
+		OP(0x1C, AbsX, NOP)
+		OP(0x1D, AbsX, ORA)
+		OP(0x1E, AbsXW, ASL_Memory)
+		OP(0x1F, AbsXW, SLO)
+		OP(0x20, Abs, JSR)
+		OP(0x21, IndX, AND)
+		OP(0x22, None, HLT)
+		OP(0x23, IndX, RLA)
+		OP(0x24, Zero, BIT)
+		OP(0x25, Zero, AND)
+		OP(0x26, Zero, ROL_Memory)
+		OP(0x27, Zero, RLA)
+		OP(0x28, Imp, PLP)
+		OP(0x29, Imm, AND)
+		OP(0x2A, Acc, ROL_Acc)
+		OP(0x2B, Imm, AAC)
+		OP(0x2C, Abs, BIT)
+		OP(0x2D, Abs, AND)
+		OP(0x2E, Abs, ROL_Memory)
+		OP(0x2F, Abs, RLA)
+		OP(0x30, Rel, BMI)
+		OP(0x31, IndY, AND)
+		OP(0x32, None, HLT)
+		OP(0x33, IndYW, RLA)
+		OP(0x34, ZeroX, NOP)
+		OP(0x35, ZeroX, AND)
+		OP(0x36, ZeroX, ROL_Memory)
+		OP(0x37, ZeroX, RLA)
+		OP(0x38, Imp, SEC)
+		OP(0x39, AbsY, AND)
+		OP(0x3A, Imp, NOP)
+		OP(0x3B, AbsYW, RLA)
+		OP(0x3C, AbsX, NOP)
+		OP(0x3D, AbsX, AND)
+		OP(0x3E, AbsXW, ROL_Memory)
+		OP(0x3F, AbsXW, RLA)
+		OP(0x40, Imp, RTI)
+		OP(0x41, IndX, EOR)
+		OP(0x42, None, HLT)
+		OP(0x43, IndX, SRE)
+		OP(0x44, Zero, NOP)
+		OP(0x45, Zero, EOR)
+		OP(0x46, Zero, LSR_Memory)
+		OP(0x47, Zero, SRE)
+		OP(0x48, Imp, PHA)
+		OP(0x49, Imm, EOR)
+		OP(0x4A, Acc, LSR_Acc)
+		OP(0x4B, Imm, ASR)
+		OP(0x4C, Abs, JMP_Abs)
+		OP(0x4D, Abs, EOR)
+		OP(0x4E, Abs, LSR_Memory)
+		OP(0x4F, Abs, SRE)
+		OP(0x50, Rel, BVC)
+		OP(0x51, IndY, EOR)
+		OP(0x52, None, HLT)
+		OP(0x53, IndYW, SRE)
+		OP(0x54, ZeroX, NOP)
+		OP(0x55, ZeroX, EOR)
+		OP(0x56, ZeroX, LSR_Memory)
+		OP(0x57, ZeroX, SRE)
+		OP(0x58, Imp, CLI)
+		OP(0x59, AbsY, EOR)
+		OP(0x5A, Imp, NOP)
+		OP(0x5B, AbsYW, SRE)
+		OP(0x5C, AbsX, NOP)
+		OP(0x5D, AbsX, EOR)
+		OP(0x5E, AbsXW, LSR_Memory)
+		OP(0x5F, AbsXW, SRE)
+		OP(0x60, Imp, RTS)
+		OP(0x61, IndX, ADC)
+		OP(0x62, None, HLT)
+		OP(0x63, IndX, RRA)
+		OP(0x64, Zero, NOP)
+		OP(0x65, Zero, ADC)
+		OP(0x66, Zero, ROR_Memory)
+		OP(0x67, Zero, RRA)
+		OP(0x68, Imp, PLA)
+		OP(0x69, Imm, ADC)
+		OP(0x6A, Acc, ROR_Acc)
+		OP(0x6B, Imm, ARR)
+		OP(0x6C, Ind, JMP_Ind)
+		OP(0x6D, Abs, ADC)
+		OP(0x6E, Abs, ROR_Memory)
+		OP(0x6F, Abs, RRA)
+		OP(0x70, Rel, BVS)
+		OP(0x71, IndY, ADC)
+		OP(0x72, None, HLT)
+		OP(0x73, IndYW, RRA)
+		OP(0x74, ZeroX, NOP)
+		OP(0x75, ZeroX, ADC)
+		OP(0x76, ZeroX, ROR_Memory)
+		OP(0x77, ZeroX, RRA)
+		OP(0x78, Imp, SEI)
+		OP(0x79, AbsY, ADC)
+		OP(0x7A, Imp, NOP)
+		OP(0x7B, AbsYW, RRA)
+		OP(0x7C, AbsX, NOP)
+		OP(0x7D, AbsX, ADC)
+		OP(0x7E, AbsXW, ROR_Memory)
+		OP(0x7F, AbsXW, RRA)
+		OP(0x80, Imm, NOP)
+		OP(0x81, IndX, STA)
+		OP(0x82, Imm, NOP)
+		OP(0x83, IndX, SAX)
+		OP(0x84, Zero, STY)
+		OP(0x85, Zero, STA)
+		OP(0x86, Zero, STX)
+		OP(0x87, Zero, SAX)
+		OP(0x88, Imp, DEY)
+		OP(0x89, Imm, NOP)
+		OP(0x8A, Imp, TXA)
+		OP(0x8B, Imm, UNK)
+		OP(0x8C, Abs, STY)
+		OP(0x8D, Abs, STA)
+		OP(0x8E, Abs, STX)
+		OP(0x8F, Abs, SAX)
+		OP(0x90, Rel, BCC)
+		OP(0x91, IndYW, STA)
+		OP(0x92, None, HLT)
+		OP(0x93, IndYW, AXA)
+		OP(0x94, ZeroX, STY)
+		OP(0x95, ZeroX, STA)
+		OP(0x96, ZeroY, STX)
+		OP(0x97, ZeroY, SAX)
+		OP(0x98, Imp, TYA)
+		OP(0x99, AbsYW, STA)
+		OP(0x9A, Imp, TXS)
+		OP(0x9B, AbsYW, TAS)
+		OP(0x9C, AbsXW, SYA)
+		OP(0x9D, AbsXW, STA)
+		OP(0x9E, AbsYW, SXA)
+		OP(0x9F, AbsYW, AXA)
+		OP(0xA0, Imm, LDY)
+		OP(0xA1, IndX, LDA)
+		OP(0xA2, Imm, LDX)
+		OP(0xA3, IndX, LAX)
+		OP(0xA4, Zero, LDY)
+		OP(0xA5, Zero, LDA)
+		OP(0xA6, Zero, LDX)
+		OP(0xA7, Zero, LAX)
+		OP(0xA8, Imp, TAY)
+		OP(0xA9, Imm, LDA)
+		OP(0xAA, Imp, TAX)
+		OP(0xAB, Imm, ATX)
+		OP(0xAC, Abs, LDY)
+		OP(0xAD, Abs, LDA)
+		OP(0xAE, Abs, LDX)
+		OP(0xAF, Abs, LAX)
+		OP(0xB0, Rel, BCS)
+		OP(0xB1, IndY, LDA)
+		OP(0xB2, None, HLT)
+		OP(0xB3, IndY, LAX)
+		OP(0xB4, ZeroX, LDY)
+		OP(0xB5, ZeroX, LDA)
+		OP(0xB6, ZeroY, LDX)
+		OP(0xB7, ZeroY, LAX)
+		OP(0xB8, Imp, CLV)
+		OP(0xB9, AbsY, LDA)
+		OP(0xBA, Imp, TSX)
+		OP(0xBB, AbsY, LAS)
+		OP(0xBC, AbsX, LDY)
+		OP(0xBD, AbsX, LDA)
+		OP(0xBE, AbsY, LDX)
+		OP(0xBF, AbsY, LAX)
+		OP(0xC0, Imm, CPY)
+		OP(0xC1, IndX, CPA)
+		OP(0xC2, Imm, NOP)
+		OP(0xC3, IndX, DCP)
+		OP(0xC4, Zero, CPY)
+		OP(0xC5, Zero, CPA)
+		OP(0xC6, Zero, DEC)
+		OP(0xC7, Zero, DCP)
+		OP(0xC8, Imp, INY)
+		OP(0xC9, Imm, CPA)
+		OP(0xCA, Imp, DEX)
+		OP(0xCB, Imm, AXS)
+		OP(0xCC, Abs, CPY)
+		OP(0xCD, Abs, CPA)
+		OP(0xCE, Abs, DEC)
+		OP(0xCF, Abs, DCP)
+		OP(0xD0, Rel, BNE)
+		OP(0xD1, IndY, CPA)
+		OP(0xD2, None, HLT)
+		OP(0xD3, IndYW, DCP)
+		OP(0xD4, ZeroX, NOP)
+		OP(0xD5, ZeroX, CPA)
+		OP(0xD6, ZeroX, DEC)
+		OP(0xD7, ZeroX, DCP)
+		OP(0xD8, Imp, CLD)
+		OP(0xD9, AbsY, CPA)
+		OP(0xDA, Imp, NOP)
+		OP(0xDB, AbsYW, DCP)
+		OP(0xDC, AbsX, NOP)
+		OP(0xDD, AbsX, CPA)
+		OP(0xDE, AbsXW, DEC)
+		OP(0xDF, AbsXW, DCP)
+		OP(0xE0, Imm, CPX)
+		OP(0xE1, IndX, SBC)
+		OP(0xE2, Imm, NOP)
+		OP(0xE3, IndX, ISB)
+		OP(0xE4, Zero, CPX)
+		OP(0xE5, Zero, SBC)
+		OP(0xE6, Zero, INC)
+		OP(0xE7, Zero, ISB)
+		OP(0xE8, Imp, INX)
+		OP(0xE9, Imm, SBC)
+		OP(0xEA, Imp, NOP)
+		OP(0xEB, Imm, SBC)
+		OP(0xEC, Abs, CPX)
+		OP(0xED, Abs, SBC)
+		OP(0xEE, Abs, INC)
+		OP(0xEF, Abs, ISB)
+		OP(0xF0, Rel, BEQ)
+		OP(0xF1, IndY, SBC)
+		OP(0xF2, None, HLT)
+		OP(0xF3, IndYW, ISB)
+		OP(0xF4, ZeroX, NOP)
+		OP(0xF5, ZeroX, SBC)
+		OP(0xF6, ZeroX, INC)
+		OP(0xF7, ZeroX, ISB)
+		OP(0xF8, Imp, SED)
+		OP(0xF9, AbsY, SBC)
+		OP(0xFA, Imp, NOP)
+		OP(0xFB, AbsYW, ISB)
+		OP(0xFC, AbsX, NOP)
+		OP(0xFD, AbsX, SBC)
+		OP(0xFE, AbsXW, INC)
+		OP(0xFF, AbsXW, ISB)
+	}
+}
+
+#undef OP
+#undef FETCH_None
+#undef FETCH_Acc
+#undef FETCH_Imp
+#undef FETCH_Imm
+#undef FETCH_Rel
+#undef FETCH_Zero
+#undef FETCH_ZeroX
+#undef FETCH_ZeroY
+#undef FETCH_Ind
+#undef FETCH_IndX
+#undef FETCH_IndY
+#undef FETCH_IndYW
+#undef FETCH_Abs
+#undef FETCH_AbsX
+#undef FETCH_AbsXW
+#undef FETCH_AbsY
+#undef FETCH_AbsYW
+
 void CPU::IRQ() 
 {
 	uint16_t originalPc = PC();
@@ -262,8 +759,15 @@ void CPU::IncCycleCount()
 		}
 	}
 
-	PPU::ExecStatic();
-	APU::ExecStatic();
+	if(_ppuCatchUp) {
+		_ppuPendingCycles++;
+	} else {
+		_ppu->ProcessCpuClock();
+	}
+	if(--_ppuSyncCountdown <= 0) {
+		SyncPpu();
+	}
+	_apu->ProcessCpuClock();
 	
 	if(!_spriteDmaTransfer && !_dmcDmaRunning) {
 		//IRQ flags are ignored during Sprite DMA - fixes irq_and_dma
@@ -275,32 +779,72 @@ void CPU::IncCycleCount()
 	}
 }
 
+void CPU::RunPendingPpuCycles()
+{
+	if(_ppuPendingCycles) {
+		uint32_t cycles = _ppuPendingCycles;
+		_ppuPendingCycles = 0;
+		_ppu->CatchUp(cycles);
+	}
+}
+
+void CPU::SyncPpu()
+{
+	RunPendingPpuCycles();
+
+	int32_t window = _ppu->GetCatchUpWindow();
+	_ppuCatchUp = window >= 0;
+
+	//In lockstep mode, check again about once per frame whether catching up is allowed
+	_ppuSyncCountdown = _ppuCatchUp ? window : 29780;
+}
+
 void CPU::RunDMATransfer(uint8_t offsetValue)
 {
+	CPU* cpu = GetInstance();
+
 	TraceLogger::LogStatic("Sprite DMA Start");
-	Instance->_spriteDmaTransfer = true;
+	cpu->_spriteDmaTransfer = true;
 	
 	//"The CPU is suspended during the transfer, which will take 513 or 514 cycles after the $4014 write tick."
 	//"(1 dummy read cycle while waiting for writes to complete, +1 if on an odd CPU cycle, then 256 alternating read/write cycles.)"
-	if(Instance->_cycleCount % 2 != 0) {
-		Instance->DummyRead();
+	if(cpu->_cycleCount % 2 != 0) {
+		cpu->DummyRead();
+	}
+	cpu->DummyRead();
+
+	cpu->_spriteDmaCounter = 256;
+
+	//When the page has no side effects to read, nothing can see OAM before the CPU runs again and the whole transfer fits before
+	//anything else happens (this excludes DMC DMA conflicts, which are left to the loop below), copy it at once and only
+	//count the transfer's cycles
+	uint8_t* source = cpu->_memoryManager->GetPlainPage(offsetValue);
+	if(source && cpu->_memoryManager->IsRegisterWriteHandler(0x2004, cpu->_ppu) && cpu->GetSkippableCycles() >= 0x200) {
+		cpu->RunPendingPpuCycles();
+		if(cpu->_ppu->IsSpriteRamIdle()) {
+			cpu->_ppu->WriteSpriteRamPage(source);
+			cpu->_memoryManager->SetLastReadValue(source[0xFF]);
+			cpu->SkipCycles(0x200);
+			cpu->_writeAddr = 0x2004;
+			cpu->_spriteDmaCounter = 0;
+			cpu->_spriteDmaTransfer = false;
+			TraceLogger::LogStatic("Sprite DMA End");
+			return;
+		}
 	}
-	Instance->DummyRead();
-
-	Instance->_spriteDmaCounter = 256;
 
 	//DMA transfer starts at SpriteRamAddr and wraps around
 	for(int i = 0; i < 0x100; i++) {
 		//Read value
-		uint8_t readValue = Instance->MemoryRead(offsetValue * 0x100 + i);
+		uint8_t readValue = cpu->MemoryRead(offsetValue * 0x100 + i);
 		
 		//Write to sprite ram via $2004 ("DMA is implemented in the 2A03/7 chip and works by repeatedly writing to OAMDATA")
-		Instance->MemoryWrite(0x2004, readValue);
+		cpu->MemoryWrite(0x2004, readValue);
 
-		Instance->_spriteDmaCounter--;
+		cpu->_spriteDmaCounter--;
 	}
 	
-	Instance->_spriteDmaTransfer = false;
+	cpu->_spriteDmaTransfer = false;
 
 	TraceLogger::LogStatic("Sprite DMA End");
 }
@@ -310,24 +854,25 @@ void CPU::StartDmcTransfer()
 	//"DMC DMA adds 4 cycles normally, 2 if it lands on the $4014 write or during OAM DMA"
 	//3 cycles if it lands on the last write cycle of any instruction
 	TraceLogger::LogStatic("DMC DMA Start");
-	Instance->_dmcDmaRunning = true;
-	if(Instance->_spriteDmaTransfer) {
-		if(Instance->_spriteDmaCounter == 2) {
-			Instance->_dmcCounter = 1;
-		} else if(Instance->_spriteDmaCounter == 1) {
-			Instance->_dmcCounter = 3;
+	CPU* cpu = GetInstance();
+	cpu->_dmcDmaRunning = true;
+	if(cpu->_spriteDmaTransfer) {
+		if(cpu->_spriteDmaCounter == 2) {
+			cpu->_dmcCounter = 1;
+		} else if(cpu->_spriteDmaCounter == 1) {
+			cpu->_dmcCounter = 3;
 		} else {
-			Instance->_dmcCounter = 2;
+			cpu->_dmcCounter = 2;
 		}
 	} else {
-		if(Instance->_cpuWrite) {
-			if(Instance->_writeAddr == 0x4014) {
-				Instance->_dmcCounter = 2;
+		if(cpu->_cpuWrite) {
+			if(cpu->_writeAddr == 0x4014) {
+				cpu->_dmcCounter = 2;
 			} else {
-				Instance->_dmcCounter = 3;
+				cpu->_dmcCounter = 3;
 			}
 		} else {
-			Instance->_dmcCounter = 4;
+			cpu->_dmcCounter = 4;
 		}
 	}
 }
@@ -344,12 +889,12 @@ uint32_t CPU::GetClockRate(NesModel model)
 
 uint8_t CPU::DebugReadByte(uint16_t addr)
 { 
-	return CPU::Instance->_memoryManager->DebugRead(addr);
+	return GetInstance()->_memoryManager->DebugRead(addr);
 }
 
 uint16_t CPU::DebugReadWord(uint16_t addr)
 {
-	return CPU::Instance->_memoryManager->DebugReadWord(addr);
+	return GetInstance()->_memoryManager->DebugReadWord(addr);
 }
 
 void CPU::StreamState(bool saving)
@@ -366,5 +911,11 @@ void CPU::StreamState(bool saving)
 	if(!saving) {
 		EmulationSettings::SetOverclockRate(overclockRate, overclockAdjustApu);
 		EmulationSettings::SetPpuNmiConfig(extraScanlinesBeforeNmi, extraScanlinesAfterNmi);
+
+		//The PPU's state was loaded too, start over in lockstep mode
+		_ppuCatchUp = false;
+		_ppuPendingCycles = 0;
+		_ppuSyncCountdown = 0;
+		_idleLoopJump = false;
 	}
 }
\ No newline at end of file
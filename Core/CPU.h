@@ -3,9 +3,12 @@
 #include "stdafx.h"
 #include "Snapshotable.h"
 #include "Types.h"
+#include "Console.h"
 
 enum class NesModel;
 class MemoryManager;
+class PPU;
+class APU;
 
 namespace PSFlags
 {
@@ -22,7 +25,7 @@ namespace PSFlags
 	};
 }
 
-enum class AddrMode
+enum class AddrMode : uint8_t
 {
 	None,	Acc, Imp, Imm, Rel,
 	Zero, Abs, ZeroX, ZeroY,
@@ -46,13 +49,19 @@ public:
 	static const uint16_t IRQVector = 0xFFFE;
 
 private:
-	static CPU* Instance;
+	static CPU* GetInstance() { return Console::GetCurrent()->GetCpu(); }
 
 	typedef void(CPU::*Func)();
 
 	int32_t _cycleCount;
 	uint16_t _operand;
 
+	//When allowed, the PPU lags behind the CPU and is only caught up when the CPU accesses anything but internal RAM/ROM,
+	//when it could set the NMI flag or start a new frame (see SyncPpu), or when something outside the CPU needs it (CatchUpPpu)
+	bool _ppuCatchUp = false;
+	uint32_t _ppuPendingCycles = 0;
+	int32_t _ppuSyncCountdown = 0;
+
 	Func _opTable[256];
 	AddrMode _addrMode[256];
 	AddrMode _instAddrMode;
@@ -69,12 +78,45 @@ private:
 
 	State _state;
 	MemoryManager *_memoryManager = nullptr;
+	PPU *_ppu = nullptr;
+	APU *_apu = nullptr;
 
 	bool _prevRunIrq = false;
 	bool _runIrq = false;
 
+	//Opcode and operand bytes of the instruction at each PRG ROM offset, see ExecDecoded (not saved in states)
+	struct DecodedInstruction
+	{
+		uint8_t OpCode;
+		AddrMode Mode;
+		//0 until the instruction is decoded, DecodedInstruction::Uncacheable if it can't be
+		uint8_t Size;
+		uint8_t Operand[2];
+
+		static const uint8_t Uncacheable = 0xFF;
+	};
+	vector<DecodedInstruction> _decodeCache;
+	//Operand bytes ReadByte returns instead of reading them, while ExecDecoded fetches the operand
+	uint8_t* _decodedOperand = nullptr;
+
+	//Set when the last instruction jumped back to what could be an idle loop, see SkipIdleLoop (not saved in states)
+	bool _idleLoopJump = false;
+	//Cycles SkipIdleLoop didn't have to emulate one by one (not saved in states)
+	uint64_t _skippedIdleCycles = 0;
+
 	void IncCycleCount();
+	void RunPendingPpuCycles();
+	void SyncPpu();
 	uint16_t FetchOperand();
+	//Alternative to the _opTable/_addrMode dispatch, used with EmulationFlags::FusedCpuCore
+	void ExecFused(uint8_t opCode);
+	//Used with EmulationFlags::PrgDecodeCache
+	bool ExecDecoded();
+	void DecodedRead(uint8_t value);
+	uint32_t GetSkippableCycles();
+	void SkipCycles(uint32_t cycles);
+	//Used with EmulationFlags::SkipIdleLoops
+	void SkipIdleLoop(uint16_t jumpAddr);
 	void IRQ();
 
 	uint8_t GetOPCode()
@@ -92,16 +134,22 @@ private:
 
 	uint8_t ReadByte()
 	{
-		uint8_t value = MemoryRead(_state.PC, MemoryOperationType::ExecOperand);
+		uint8_t value;
+		if(_decodedOperand) {
+			value = *_decodedOperand++;
+			DecodedRead(value);
+		} else {
+			value = MemoryRead(_state.PC, MemoryOperationType::ExecOperand);
+		}
 		_state.PC++;
 		return value;
 	}
 
 	uint16_t ReadWord()
 	{
-		uint16_t value = MemoryReadWord(_state.PC, MemoryOperationType::ExecOperand);
-		_state.PC += 2;
-		return value;
+		uint8_t lo = ReadByte();
+		uint8_t hi = ReadByte();
+		return lo | hi << 8;
 	}
 
 	void ClearFlags(uint8_t flags)
@@ -785,17 +833,25 @@ public:
 	static const uint32_t ClockRateDendy = 1773448;
 
 	CPU(MemoryManager *memoryManager);
-	static int32_t GetCycleCount() { return CPU::Instance->_cycleCount; }
-	static void SetNMIFlag() { CPU::Instance->_state.NMIFlag = true; }
-	static void ClearNMIFlag() { CPU::Instance->_state.NMIFlag = false; }
-	static void SetIRQMask(uint8_t mask) { CPU::Instance->_irqMask = mask; }
-	static void SetIRQSource(IRQSource source) { CPU::Instance->_state.IRQFlag |= (int)source; }
-	static bool HasIRQSource(IRQSource source) { return (CPU::Instance->_state.IRQFlag & (int)source) != 0; }
-	static void ClearIRQSource(IRQSource source) { CPU::Instance->_state.IRQFlag &= ~(int)source; }
+
+	//The console sets these whenever it creates (or replaces) its PPU/APU, which the CPU clocks on every cycle
+	void SetPpu(PPU *ppu) { _ppu = ppu; }
+	void SetApu(APU *apu) { _apu = apu; }
+	static int32_t GetCycleCount() { return GetInstance()->_cycleCount; }
+	static uint64_t GetSkippedIdleCycles() { return GetInstance()->_skippedIdleCycles; }
+	static void SetNMIFlag() { GetInstance()->_state.NMIFlag = true; }
+	static void ClearNMIFlag() { GetInstance()->_state.NMIFlag = false; }
+	static void SetIRQMask(uint8_t mask) { GetInstance()->_irqMask = mask; }
+	static void SetIRQSource(IRQSource source) { GetInstance()->_state.IRQFlag |= (int)source; }
+	static bool HasIRQSource(IRQSource source) { return (GetInstance()->_state.IRQFlag & (int)source) != 0; }
+	static void ClearIRQSource(IRQSource source) { GetInstance()->_state.IRQFlag &= ~(int)source; }
 	static void RunDMATransfer(uint8_t offsetValue);
 	static void StartDmcTransfer();	
 	static uint32_t GetClockRate(NesModel model);
-	static bool IsCpuWrite() { return CPU::Instance->_cpuWrite; }
+	static bool IsCpuWrite() { return GetInstance()->_cpuWrite; }
+	static void CatchUpPpu() { GetInstance()->RunPendingPpuCycles(); }
+	//Catches up and checks again whether the PPU can lag behind - after something it depends on changed (see PPU::GetCatchUpWindow)
+	static void ResyncPpu() { GetInstance()->SyncPpu(); }
 
 	static uint8_t DebugReadByte(uint16_t addr);
 	static uint16_t DebugReadWord(uint16_t addr);
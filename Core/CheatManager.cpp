@@ -4,8 +4,6 @@
 #include "Console.h"
 #include "MessageManager.h"
 
-CheatManager* CheatManager::Instance = new CheatManager();
-
 CheatManager::CheatManager()
 {
 	for(int i = 0; i <= 0xFFFF; i++) {
@@ -15,7 +13,7 @@ CheatManager::CheatManager()
 
 CheatManager * CheatManager::GetInstance()
 {
-	return Instance;
+	return Console::GetCurrent()->GetCheatManager();
 }
 
 uint32_t CheatManager::DecodeValue(uint32_t code, uint32_t* bitIndexes, uint32_t bitCount)
@@ -99,9 +97,11 @@ void CheatManager::AddCode(CodeInfo &code)
 			_relativeCheatCodes[code.Address].reset(new vector<CodeInfo>());
 		}
 		_relativeCheatCodes[code.Address]->push_back(code);
+		_relativeCheatCount++;
 	} else {
 		_absoluteCheatCodes.push_back(code);
 	}
+	Console::GetCurrent()->UpdateMemoryAccessMode();
 	MessageManager::SendNotification(ConsoleNotificationType::CheatAdded);
 }
 
@@ -133,7 +133,7 @@ void CheatManager::ClearCodes()
 	bool cheatRemoved = false;
 
 	for(int i = 0; i <= 0xFFFF; i++) {
-		if(!_relativeCheatCodes[i]) {
+		if(_relativeCheatCodes[i]) {
 			cheatRemoved = true;
 		}
 		_relativeCheatCodes[i].reset();
@@ -141,6 +141,8 @@ void CheatManager::ClearCodes()
 
 	cheatRemoved |= _absoluteCheatCodes.size() > 0;
 	_absoluteCheatCodes.clear();
+	_relativeCheatCount = 0;
+	Console::GetCurrent()->UpdateMemoryAccessMode();
 	
 	if(cheatRemoved) {
 		MessageManager::SendNotification(ConsoleNotificationType::CheatRemoved);
@@ -149,9 +151,10 @@ void CheatManager::ClearCodes()
 
 void CheatManager::ApplyRamCodes(uint16_t addr, uint8_t &value)
 {
-	if(Instance->_relativeCheatCodes[addr] != nullptr) {
-		for(uint32_t i = 0, len = i < Instance->_relativeCheatCodes[addr]->size(); i < len; i++) {
-			CodeInfo code = Instance->_relativeCheatCodes[addr]->at(i);
+	CheatManager* instance = GetInstance();
+	if(instance->_relativeCheatCodes[addr] != nullptr) {
+		for(uint32_t i = 0, len = i < instance->_relativeCheatCodes[addr]->size(); i < len; i++) {
+			CodeInfo code = instance->_relativeCheatCodes[addr]->at(i);
 			if(code.CompareValue == -1 || code.CompareValue == value) {
 				value = code.Value;
 				return;
@@ -160,10 +163,21 @@ void CheatManager::ApplyRamCodes(uint16_t addr, uint8_t &value)
 	}
 }
 
+bool CheatManager::HasRamCodes()
+{
+	return _relativeCheatCount > 0;
+}
+
+bool CheatManager::HasPrgCodes()
+{
+	return !GetInstance()->_absoluteCheatCodes.empty();
+}
+
 void CheatManager::ApplyPrgCodes(uint8_t *prgRam, uint32_t prgSize)
 {
-	for(uint32_t i = 0, len = i < Instance->_absoluteCheatCodes.size(); i < len; i++) {
-		CodeInfo code = Instance->_absoluteCheatCodes[i];
+	CheatManager* instance = GetInstance();
+	for(uint32_t i = 0, len = i < instance->_absoluteCheatCodes.size(); i < len; i++) {
+		CodeInfo code = instance->_absoluteCheatCodes[i];
 		if(code.Address < prgSize) {
 			if(code.CompareValue == -1 || code.CompareValue == prgRam[code.Address]) {
 				prgRam[code.Address] = code.Value;
@@ -175,28 +189,30 @@ void CheatManager::ApplyPrgCodes(uint8_t *prgRam, uint32_t prgSize)
 vector<CodeInfo> CheatManager::GetCheats()
 {
 	//Used by NetPlay
+	CheatManager* instance = GetInstance();
 	vector<CodeInfo> cheats;
-	for(unique_ptr<vector<CodeInfo>> &codes : Instance->_relativeCheatCodes) {
+	for(unique_ptr<vector<CodeInfo>> &codes : instance->_relativeCheatCodes) {
 		if(codes) {
 			std::copy(codes.get()->begin(), codes.get()->end(), std::back_inserter(cheats));
 		}
 	}
-	std::copy(Instance->_absoluteCheatCodes.begin(), Instance->_absoluteCheatCodes.end(), std::back_inserter(cheats));
+	std::copy(instance->_absoluteCheatCodes.begin(), instance->_absoluteCheatCodes.end(), std::back_inserter(cheats));
 	return cheats;
 }
 
 void CheatManager::SetCheats(CheatInfo cheats[], uint32_t length)
 {
+	CheatManager* instance = GetInstance();
 	Console::Pause();
 
-	Instance->ClearCodes();
+	instance->ClearCodes();
 
 	for(uint32_t i = 0; i < length; i++) {
 		CheatInfo &cheat = cheats[i];
 		switch(cheat.Type) {
-			case CheatType::Custom: Instance->AddCustomCode(cheat.Address, cheat.Value, cheat.UseCompareValue ? cheat.CompareValue : -1, cheat.IsRelativeAddress); break;
-			case CheatType::GameGenie: Instance->AddGameGenieCode(cheat.GameGenieCode);	break;
-			case CheatType::ProActionRocky: Instance->AddProActionRockyCode(cheat.ProActionRockyCode); break;
+			case CheatType::Custom: instance->AddCustomCode(cheat.Address, cheat.Value, cheat.UseCompareValue ? cheat.CompareValue : -1, cheat.IsRelativeAddress); break;
+			case CheatType::GameGenie: instance->AddGameGenieCode(cheat.GameGenieCode);	break;
+			case CheatType::ProActionRocky: instance->AddProActionRockyCode(cheat.ProActionRockyCode); break;
 		}
 	}
 
@@ -206,12 +222,13 @@ void CheatManager::SetCheats(CheatInfo cheats[], uint32_t length)
 void CheatManager::SetCheats(vector<CodeInfo> &cheats)
 {
 	//Used by NetPlay
-	Instance->ClearCodes();
+	CheatManager* instance = GetInstance();
+	instance->ClearCodes();
 
 	if(cheats.size() > 0) {
 		MessageManager::DisplayMessage("Cheats", cheats.size() > 1 ? "CheatsApplied" : "CheatApplied", std::to_string(cheats.size()));
 		for(CodeInfo &cheat : cheats) {
-			Instance->AddCode(cheat);
+			instance->AddCode(cheat);
 		}
 	}
 }
\ No newline at end of file
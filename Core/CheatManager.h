@@ -32,9 +32,9 @@ struct CheatInfo
 class CheatManager
 {
 private:
-	static CheatManager* Instance;
 	vector<unique_ptr<vector<CodeInfo>>> _relativeCheatCodes;
 	vector<CodeInfo> _absoluteCheatCodes;
+	uint32_t _relativeCheatCount = 0;
 
 	uint32_t DecodeValue(uint32_t code, uint32_t* bitIndexes, uint32_t bitCount);
 	CodeInfo GetGGCodeInfo(string ggCode);
@@ -55,6 +55,8 @@ public:
 	static void SetCheats(vector<CodeInfo> &cheats);
 	static void SetCheats(CheatInfo cheats[], uint32_t length);
 
+	static bool HasPrgCodes();
+	bool HasRamCodes();
 	static void ApplyRamCodes(uint16_t addr, uint8_t &value);
 	static void ApplyPrgCodes(uint8_t *prgRam, uint32_t prgSize);
 };
\ No newline at end of file
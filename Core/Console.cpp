@@ -30,13 +30,16 @@
 #include "SaveStateManager.h"
 #include "HdPackBuilder.h"
 #include "HdAudioDevice.h"
+#include "CheatManager.h"
 
 shared_ptr<Console> Console::Instance(new Console());
+thread_local Console* Console::_boundConsole = nullptr;
 
 Console::Console()
 {
 	_resetRequested = false;
 	_lagCounter = 0;
+	_cheatManager.reset(new CheatManager());
 }
 
 Console::~Console()
@@ -47,7 +50,7 @@ Console::~Console()
 
 shared_ptr<Console> Console::GetInstance()
 {
-	return Console::Instance;
+	return GetCurrent()->shared_from_this();
 }
 
 void Console::Release()
@@ -65,7 +68,9 @@ bool Console::Initialize(VirtualFile &romFile, VirtualFile &patchFile)
 		_mapper->SaveBattery();
 
 		//Save current game state before loading another one
-		SaveStateManager::SaveRecentGame(_mapper->GetRomName(), _romFilepath, _patchFilename);
+		if(IsDefaultInstance()) {
+			SaveStateManager::SaveRecentGame(_mapper->GetRomName(), _romFilepath, _patchFilename);
+		}
 	}
 	
 	if(romFile.IsValid()) {
@@ -90,23 +95,27 @@ bool Console::Initialize(VirtualFile &romFile, VirtualFile &patchFile)
 			_romFilepath = romFile;
 			_patchFilename = patchFile;
 
-			_autoSaveManager.reset(new AutoSaveManager());
+			//Auto-saves (and their background thread) are only used by the console attached to the UI
+			_autoSaveManager.reset(IsDefaultInstance() ? new AutoSaveManager() : nullptr);
 			//VideoDecoder::GetInstance()->StopThread();
 			
 			_mapper = mapper;
+			_mapper->SetConsole(this);
 			_memoryManager.reset(new MemoryManager(_mapper));
 			_cpu.reset(new CPU(_memoryManager.get()));
 
 			if(_hdData && (!_hdData->Tiles.empty() || !_hdData->Backgrounds.empty())) {
-				_ppu.reset(new HdPpu(_mapper.get(), _hdData->Version));
+				_ppu.reset(new HdPpu(this, _mapper.get(), _hdData->Version));
 			} else if(NsfMapper::GetInstance()) {
 				//Disable most of the PPU for NSFs
-				_ppu.reset(new NsfPpu(_mapper.get()));
+				_ppu.reset(new NsfPpu(this, _mapper.get()));
 			} else {
-				_ppu.reset(new PPU(_mapper.get()));
+				_ppu.reset(new PPU(this, _mapper.get()));
 			}
 			
 			_apu.reset(new APU(_memoryManager.get()));
+			_cpu->SetPpu(_ppu.get());
+			_cpu->SetApu(_apu.get());
 
 			_controlManager.reset(_mapper->GetGameSystem() == GameSystem::VsUniSystem ? new VsControlManager() : new ControlManager());
 			_controlManager->UpdateControlDevices();
@@ -130,6 +139,7 @@ bool Console::Initialize(VirtualFile &romFile, VirtualFile &patchFile)
 				StopDebugger();
 				GetDebugger();
 			}
+			UpdateMemoryAccessMode();
 
 			ResetComponents(false);
 
@@ -156,7 +166,7 @@ bool Console::Initialize(VirtualFile &romFile, VirtualFile &patchFile)
 bool Console::LoadROM(VirtualFile romFile, VirtualFile patchFile)
 {
 	Console::Pause();
-	bool result = Instance->Initialize(romFile, patchFile);
+	bool result = GetCurrent()->Initialize(romFile, patchFile);
 	Console::Resume();
 	return result;
 }
@@ -166,7 +176,7 @@ bool Console::LoadROM(string romName, HashInfo hashInfo)
 	string currentRomFilepath = Console::GetRomPath().GetFilePath();
 	string currentFolder = FolderUtilities::GetFolderName(currentRomFilepath);
 	if(!currentRomFilepath.empty()) {
-		HashInfo gameHashInfo = Instance->_mapper->GetHashInfo();
+		HashInfo gameHashInfo = GetCurrent()->_mapper->GetHashInfo();
 		if(gameHashInfo.Crc32Hash == hashInfo.Crc32Hash || gameHashInfo.Sha1Hash.compare(hashInfo.Sha1Hash) == 0 || gameHashInfo.PrgChrMd5Hash.compare(hashInfo.PrgChrMd5Hash) == 0) {
 			//Current game matches, no need to do anything
 			return true;
@@ -198,13 +208,14 @@ bool Console::LoadROM(string romName, HashInfo hashInfo)
 
 VirtualFile Console::GetRomPath()
 {
-	return static_cast<VirtualFile>(Instance->_romFilepath);
+	return static_cast<VirtualFile>(GetCurrent()->_romFilepath);
 }
 
 string Console::GetRomName()
 {
-	if(Instance->_mapper) {
-		return Instance->_mapper->GetRomName();
+	Console* console = GetCurrent();
+	if(console->_mapper) {
+		return console->_mapper->GetRomName();
 	} else {
 		return "";
 	}
@@ -212,8 +223,9 @@ string Console::GetRomName()
 
 RomFormat Console::GetRomFormat()
 {
-	if(Instance->_mapper) {
-		return Instance->_mapper->GetRomFormat();
+	Console* console = GetCurrent();
+	if(console->_mapper) {
+		return console->_mapper->GetRomFormat();
 	} else {
 		return RomFormat::Unknown;
 	}
@@ -221,8 +233,9 @@ RomFormat Console::GetRomFormat()
 
 bool Console::IsChrRam()
 {
-	if(Instance->_mapper) {
-		return Instance->_mapper->HasChrRam();
+	Console* console = GetCurrent();
+	if(console->_mapper) {
+		return console->_mapper->HasChrRam();
 	} else {
 		return false;
 	}
@@ -230,27 +243,30 @@ bool Console::IsChrRam()
 
 HashInfo Console::GetHashInfo()
 {
-	if(Instance->_mapper) {
-		return Instance->_mapper->GetHashInfo();
+	Console* console = GetCurrent();
+	if(console->_mapper) {
+		return console->_mapper->GetHashInfo();
 	} else {
 		return {};
 	}
 }
 NesModel Console::GetModel()
 {
-	return Instance->_model;
+	return GetCurrent()->_model;
 }
 
 void Console::PowerCycle()
 {
-	if(Instance->_initialized && !Instance->_romFilepath.empty()) {
-		LoadROM(Instance->_romFilepath, Instance->_patchFilename);
+	Console* console = GetCurrent();
+	if(console->_initialized && !console->_romFilepath.empty()) {
+		LoadROM(console->_romFilepath, console->_patchFilename);
 	}
 }
 
 void Console::Reset(bool softReset)
 {
-	if(Instance->_initialized) {
+	Console* console = GetCurrent();
+	if(console->_initialized) {
 		if(softReset && EmulationSettings::CheckFlag(EmulationFlags::DisablePpuReset)) {
 			//Allow mid-frame resets to allow the PPU to get out-of-sync
 			RequestReset();
@@ -259,12 +275,12 @@ void Console::Reset(bool softReset)
 			SoundMixer::StopRecording();
 
 			Console::Pause();
-			if(Instance->_initialized) {
+			if(console->_initialized) {
 				if(softReset) {
-					Instance->ResetComponents(softReset);
+					console->ResetComponents(softReset);
 				} else {
 					//Full reset of all objects to ensure the emulator always starts in the exact same state
-					LoadROM(Instance->_romFilepath, Instance->_patchFilename);
+					LoadROM(console->_romFilepath, console->_patchFilename);
 				}
 			}
 			Console::Resume();
@@ -309,22 +325,21 @@ void Console::Stop()
 
 void Console::Pause()
 {
-	shared_ptr<Debugger> debugger = Console::Instance->_debugger;
+	Console* console = GetCurrent();
+	shared_ptr<Debugger> debugger = console->_debugger;
 	if(debugger) {
 		//Make sure debugger resumes if we try to pause the emu, otherwise we will get deadlocked.
 		debugger->Suspend();
 	}
-	Console::Instance->_pauseLock.Acquire();
-	//Spin wait until emu pauses
-	Console::Instance->_runLock.Acquire();
+	console->_pauseLock.Pause();
 }
 
 void Console::Resume()
 {
-	Console::Instance->_runLock.Release();
-	Console::Instance->_pauseLock.Release();
+	Console* console = GetCurrent();
+	console->_pauseLock.Resume();
 	
-	shared_ptr<Debugger> debugger = Console::Instance->_debugger;
+	shared_ptr<Debugger> debugger = console->_debugger;
 	if(debugger) {
 		//Make sure debugger resumes if we try to pause the emu, otherwise we will get deadlocked.
 		debugger->Resume();
@@ -332,18 +347,20 @@ void Console::Resume()
 }
 
 void Console::RunOneStep() {
-  Console::Instance->_cpu->Exec();
+  GetCurrent()->_cpu->Exec();
 }
 
 void Console::Run()
 {
+	ConsoleBinding binding(this);
+
 	Timer clockTimer;
 	double targetTime;
 	uint32_t lastFrameNumber = -1;
 	
 	_autoSaveManager.reset(new AutoSaveManager());
 
-	_runLock.Acquire();
+	_pauseLock.AcquireRun();
 	_stopLock.Acquire();
 
 	targetTime = GetFrameDelay();
@@ -367,34 +384,40 @@ void Console::Run()
 		if(_resetRequested) {
 			//Used by NSF player to reset console after changing track
 			//Also used with DisablePpuReset option to reset mid-frame
+			CPU::CatchUpPpu();
 			MovieManager::Stop();
 			ResetComponents(true);
 			_resetRequested = false;
 		}
 
+		if(_pauseLock.IsPauseRequested()) {
+			//Another thread needs the emulation stopped (to save/load a state, etc.), let it have it until it resumes
+			CPU::CatchUpPpu();
+			_pauseLock.WaitWhilePaused();
+		}
+
 		uint32_t currentFrameNumber = PPU::GetFrameCount();
 		if(currentFrameNumber != lastFrameNumber) {
+			//Let the PPU catch up with the CPU before anything else (UI, rewind, pausing) looks at it
+			CPU::CatchUpPpu();
+
 			if(_controlManager->GetLagFlag()) {
 				_lagCounter++;
 			}
 
-			_rewindManager->ProcessEndOfFrame();
+			if(_rewindManager) {
+				_rewindManager->ProcessEndOfFrame();
+			}
 			EmulationSettings::DisableOverclocking(_disableOcNextFrame || NsfMapper::GetInstance());
 			_disableOcNextFrame = false;
 
 			lastFrameNumber = PPU::GetFrameCount();
 
-			//Sleep until we're ready to start the next frame
-			clockTimer.WaitUntil(targetTime);
-			
-			if(!_pauseLock.IsFree()) {
-				//Need to temporarely pause the emu (to save/load a state, etc.)
-				_runLock.Release();
-
-				//Spin wait until we are allowed to start again
-				_pauseLock.WaitForRelease();
-
-				_runLock.Acquire();
+			//Sleep until we're ready to start the next frame, or until another thread needs to pause the emulation (after which
+			//the frame starts late, and the next ones catch up like after any other lag)
+			double sleepTime = targetTime - clockTimer.GetElapsedMS();
+			if(sleepTime > 1 && _pauseLock.WaitForPauseRequest(sleepTime)) {
+				_pauseLock.WaitWhilePaused();
 			}
 
 			shared_ptr<Debugger> debugger = _debugger;
@@ -406,7 +429,7 @@ void Console::Run()
 				//Prevent audio from looping endlessly while game is paused
 				SoundMixer::StopAudio();
 
-				_runLock.Release();
+				_pauseLock.ReleaseRun();
 				
 				PlatformUtilities::EnableScreensaver();
 				while(paused && !_stop && (!debugger || !debugger->CheckFlag(DebuggerFlags::DebuggerWindowEnabled))) {
@@ -421,7 +444,7 @@ void Console::Run()
 				}
 
 				PlatformUtilities::DisableScreensaver();
-				_runLock.Acquire();								
+				_pauseLock.AcquireRun();
 				MessageManager::SendNotification(ConsoleNotificationType::GameResumed);
 			}
 
@@ -456,7 +479,7 @@ void Console::Run()
 	_autoSaveManager.reset();
 	StopRecordingHdPack();
 	_stopLock.Release();
-	_runLock.Release();
+	_pauseLock.ReleaseRun();
 	_hdPackBuilder.reset();
 	_hdData.reset();
 
@@ -464,7 +487,7 @@ void Console::Run()
 }
 
 void Console::Halt() {
-  Console::Instance->Shutdown();
+  GetCurrent()->Shutdown();
 }
 
 void Console::Shutdown() {
@@ -489,13 +512,14 @@ void Console::Shutdown() {
 
 bool Console::IsRunning()
 {
-	return !Instance->_stopLock.IsFree() && !Instance->_runLock.IsFree();
+	Console* console = GetCurrent();
+	return !console->_stopLock.IsFree() && console->_pauseLock.IsHeld();
 }
 
 void Console::UpdateNesModel(bool sendNotification)
 {
 	bool configChanged = false;
-	if(EmulationSettings::NeedControllerUpdate()) {
+	if(EmulationSettings::NeedControllerUpdate(_controllerRevision)) {
 		_controlManager->UpdateControlDevices();
 		configChanged = true;
 	}
@@ -548,15 +572,18 @@ double Console::GetFrameDelay()
 
 void Console::SaveState(ostream &saveStream)
 {
-	if(Instance->_initialized) {
-		Instance->_cpu->SaveSnapshot(&saveStream);
-		Instance->_ppu->SaveSnapshot(&saveStream);
-		Instance->_memoryManager->SaveSnapshot(&saveStream);
-		Instance->_apu->SaveSnapshot(&saveStream);
-		Instance->_controlManager->SaveSnapshot(&saveStream);
-		Instance->_mapper->SaveSnapshot(&saveStream);
-		if(Instance->_hdAudioDevice) {
-			Instance->_hdAudioDevice->SaveSnapshot(&saveStream);
+	Console* console = GetCurrent();
+	if(console->_initialized) {
+		//The PPU can lag behind the CPU, let it catch up before saving either of them
+		CPU::CatchUpPpu();
+		console->_cpu->SaveSnapshot(&saveStream);
+		console->_ppu->SaveSnapshot(&saveStream);
+		console->_memoryManager->SaveSnapshot(&saveStream);
+		console->_apu->SaveSnapshot(&saveStream);
+		console->_controlManager->SaveSnapshot(&saveStream);
+		console->_mapper->SaveSnapshot(&saveStream);
+		if(console->_hdAudioDevice) {
+			console->_hdAudioDevice->SaveSnapshot(&saveStream);
 		} else {
 			Snapshotable::WriteEmptyBlock(&saveStream);
 		}
@@ -565,19 +592,20 @@ void Console::SaveState(ostream &saveStream)
 
 void Console::LoadState(istream &loadStream)
 {
-	if(Instance->_initialized) {
+	Console* console = GetCurrent();
+	if(console->_initialized) {
 		//Stop any movie that might have been playing/recording if a state is loaded
 		//(Note: Loading a state is disabled in the UI while a movie is playing/recording)
 		MovieManager::Stop();
 
-		Instance->_cpu->LoadSnapshot(&loadStream);
-		Instance->_ppu->LoadSnapshot(&loadStream);
-		Instance->_memoryManager->LoadSnapshot(&loadStream);
-		Instance->_apu->LoadSnapshot(&loadStream);
-		Instance->_controlManager->LoadSnapshot(&loadStream);
-		Instance->_mapper->LoadSnapshot(&loadStream);
-		if(Instance->_hdAudioDevice) {
-			Instance->_hdAudioDevice->LoadSnapshot(&loadStream);
+		console->_cpu->LoadSnapshot(&loadStream);
+		console->_ppu->LoadSnapshot(&loadStream);
+		console->_memoryManager->LoadSnapshot(&loadStream);
+		console->_apu->LoadSnapshot(&loadStream);
+		console->_controlManager->LoadSnapshot(&loadStream);
+		console->_mapper->LoadSnapshot(&loadStream);
+		if(console->_hdAudioDevice) {
+			console->_hdAudioDevice->LoadSnapshot(&loadStream);
 		} else {
 			Snapshotable::SkipBlock(&loadStream);
 		}
@@ -588,20 +616,202 @@ void Console::LoadState(istream &loadStream)
 
 void Console::LoadState(uint8_t *buffer, uint32_t bufferSize)
 {
+	Console* console = GetCurrent();
+
 	//Send any unprocessed sound to the SoundMixer - needed for rewind
-	Instance->_apu->EndFrame();
+	console->_apu->EndFrame();
+
+	if(console->_initialized) {
+		//Stop any movie that might have been playing/recording if a state is loaded
+		MovieManager::Stop();
+
+		LoadStateFrom(buffer, bufferSize);
+
+		MessageManager::SendNotification(ConsoleNotificationType::StateLoaded);
+	}
+}
+
+uint32_t Console::SaveStateTo(uint8_t *buffer, uint32_t bufferSize)
+{
+	Console* console = GetCurrent();
+	if(!console->_initialized) {
+		return 0;
+	}
+
+	//Same as SaveState: the PPU can lag behind the CPU
+	CPU::CatchUpPpu();
+
+	//Same order as SaveState - a null entry is written as an empty block
+	Snapshotable* components[7] = {
+		console->_cpu.get(), console->_ppu.get(), console->_memoryManager.get(), console->_apu.get(),
+		console->_controlManager.get(), console->_mapper.get(), console->_hdAudioDevice.get()
+	};
 
-	stringstream stream;
-	stream.write((char*)buffer, bufferSize);
-	stream.seekg(0, ios::beg);
-	LoadState(stream);
+	uint32_t size = 0;
+	for(Snapshotable* component : components) {
+		uint32_t available = size < bufferSize ? bufferSize - size : 0;
+		if(component) {
+			size += component->SaveSnapshot(available ? buffer + size : nullptr, available);
+		} else {
+			if(available >= sizeof(uint32_t)) {
+				memset(buffer + size, 0, sizeof(uint32_t));
+			}
+			size += sizeof(uint32_t);
+		}
+	}
+	return size;
+}
+
+bool Console::LoadStateFrom(uint8_t *buffer, uint32_t bufferSize)
+{
+	Console* console = GetCurrent();
+	if(!console->_initialized) {
+		return false;
+	}
+
+	Snapshotable* components[7] = {
+		console->_cpu.get(), console->_ppu.get(), console->_memoryManager.get(), console->_apu.get(),
+		console->_controlManager.get(), console->_mapper.get(), console->_hdAudioDevice.get()
+	};
+
+	//Every component's snapshot starts with its size - make sure they are all there before loading anything
+	//(position never exceeds bufferSize, so these checks can't overflow whatever the sizes in the buffer are)
+	uint32_t position = 0;
+	for(int i = 0; i < 7; i++) {
+		uint32_t size;
+		if(bufferSize - position < sizeof(uint32_t)) {
+			return false;
+		}
+		memcpy(&size, buffer + position, sizeof(uint32_t));
+		if(size > bufferSize - position - sizeof(uint32_t)) {
+			return false;
+		}
+		position += sizeof(uint32_t) + size;
+	}
+
+	position = 0;
+	for(int i = 0; i < 7; i++) {
+		if(components[i]) {
+			position += components[i]->LoadSnapshot(buffer + position, bufferSize - position);
+		} else {
+			//Skip the block (e.g HD audio state when no HD pack is loaded)
+			uint32_t size;
+			memcpy(&size, buffer + position, sizeof(uint32_t));
+			position += sizeof(uint32_t) + size;
+		}
+	}
+	return true;
+}
+
+//Small enough for RAM/nametable/CHR-RAM writes to only dirty a few pages, large enough to keep the page bitmap small
+static constexpr uint32_t StateDeltaPageSize = 256;
+static constexpr uint32_t StateDeltaHeaderSize = sizeof(uint32_t) * 2;
+
+//Full state used to build (on save) or rebuild (on load) delta states
+static thread_local vector<uint8_t> _deltaStateBuffer;
+
+uint32_t Console::SaveStateDelta(uint8_t *parentState, uint32_t parentSize, uint8_t *buffer, uint32_t bufferSize)
+{
+	uint32_t stateSize = SaveStateTo(_deltaStateBuffer.data(), (uint32_t)_deltaStateBuffer.size());
+	if(stateSize > _deltaStateBuffer.size()) {
+		_deltaStateBuffer.resize(stateSize);
+		SaveStateTo(_deltaStateBuffer.data(), stateSize);
+	}
+	if(stateSize == 0) {
+		return 0;
+	}
+
+	uint8_t *state = _deltaStateBuffer.data();
+
+	//The PPU's output buffers are most of the state and change on almost every frame: they are not part of the delta.
+	//The parent's picture is put in their place, so a delta only carries what the emulation needs to continue.
+	uint32_t cpuStateSize;
+	memcpy(&cpuStateSize, state, sizeof(uint32_t));
+	uint32_t outputOffset, outputSize;
+	GetCurrent()->_ppu->GetOutputBuffersStateRange(outputOffset, outputSize);
+	outputOffset += sizeof(uint32_t) + cpuStateSize;
+	if(parentSize == stateSize && outputOffset + outputSize <= stateSize) {
+		memcpy(state + outputOffset, parentState + outputOffset, outputSize);
+	}
+
+	uint32_t pageCount = (stateSize + StateDeltaPageSize - 1) / StateDeltaPageSize;
+	uint32_t bitmapSize = (pageCount + 7) / 8;
+
+	//First pass: find the size of the delta, so nothing is written when the buffer is too small
+	uint32_t deltaSize = StateDeltaHeaderSize + bitmapSize;
+	for(uint32_t page = 0; page < pageCount; page++) {
+		uint32_t start = page * StateDeltaPageSize;
+		uint32_t length = std::min(StateDeltaPageSize, stateSize - start);
+		if(start + length > parentSize || memcmp(state + start, parentState + start, length) != 0) {
+			deltaSize += length;
+		}
+	}
+	if(deltaSize > bufferSize) {
+		return deltaSize;
+	}
+
+	memcpy(buffer, &stateSize, sizeof(uint32_t));
+	memcpy(buffer + sizeof(uint32_t), &parentSize, sizeof(uint32_t));
+	uint8_t *bitmap = buffer + StateDeltaHeaderSize;
+	memset(bitmap, 0, bitmapSize);
+	uint8_t *out = bitmap + bitmapSize;
+	for(uint32_t page = 0; page < pageCount; page++) {
+		uint32_t start = page * StateDeltaPageSize;
+		uint32_t length = std::min(StateDeltaPageSize, stateSize - start);
+		if(start + length > parentSize || memcmp(state + start, parentState + start, length) != 0) {
+			bitmap[page >> 3] |= 1 << (page & 0x07);
+			memcpy(out, state + start, length);
+			out += length;
+		}
+	}
+	return deltaSize;
+}
+
+bool Console::LoadStateDelta(uint8_t *parentState, uint32_t parentSize, uint8_t *delta, uint32_t deltaSize)
+{
+	if(deltaSize < StateDeltaHeaderSize) {
+		return false;
+	}
+
+	uint32_t stateSize, deltaParentSize;
+	memcpy(&stateSize, delta, sizeof(uint32_t));
+	memcpy(&deltaParentSize, delta + sizeof(uint32_t), sizeof(uint32_t));
+	uint32_t pageCount = (stateSize + StateDeltaPageSize - 1) / StateDeltaPageSize;
+	uint32_t bitmapSize = (pageCount + 7) / 8;
+	if(deltaParentSize != parentSize || deltaSize - StateDeltaHeaderSize < bitmapSize) {
+		return false;
+	}
+
+	if(_deltaStateBuffer.size() < stateSize) {
+		_deltaStateBuffer.resize(stateSize);
+	}
+	uint8_t *state = _deltaStateBuffer.data();
+	uint8_t *bitmap = delta + StateDeltaHeaderSize;
+	uint32_t position = StateDeltaHeaderSize + bitmapSize;
+	for(uint32_t page = 0; page < pageCount; page++) {
+		uint32_t start = page * StateDeltaPageSize;
+		uint32_t length = std::min(StateDeltaPageSize, stateSize - start);
+		if(bitmap[page >> 3] & (1 << (page & 0x07))) {
+			if(deltaSize - position < length) {
+				return false;
+			}
+			memcpy(state + start, delta + position, length);
+			position += length;
+		} else if(start + length <= parentSize) {
+			memcpy(state + start, parentState + start, length);
+		} else {
+			return false;
+		}
+	}
+	return LoadStateFrom(state, stateSize);
 }
 
 std::shared_ptr<Debugger> Console::GetDebugger(bool autoStart)
 {
 	auto lock = _debuggerLock.AcquireSafe();
 	if(!_debugger && autoStart) {
-		_debugger.reset(new Debugger(Console::Instance, _cpu, _ppu, _apu, _memoryManager, _mapper));
+		_debugger.reset(new Debugger(shared_from_this(), _cpu, _ppu, _apu, _memoryManager, _mapper));
+		UpdateMemoryAccessMode();
 	}
 	return _debugger;
 }
@@ -610,41 +820,65 @@ void Console::StopDebugger()
 {
 	auto lock = _debuggerLock.AcquireSafe();
 	_debugger.reset();
+	UpdateMemoryAccessMode();
+}
+
+void Console::UpdateMemoryAccessMode()
+{
+	//Only go through the cheat/debugger hooks on every CPU memory access when they can actually do something
+	if(_memoryManager) {
+		if(_debugger) {
+			_memoryManager->SetAccessMode(MemoryAccessMode::Debug);
+		} else if(_cheatManager && _cheatManager->HasRamCodes()) {
+			_memoryManager->SetAccessMode(MemoryAccessMode::Cheats);
+		} else {
+			_memoryManager->SetAccessMode(MemoryAccessMode::Plain);
+		}
+	}
+}
+
+void Console::SetForceMapperHooks(bool force)
+{
+	if(_mapper) {
+		_mapper->SetForceHooks(force);
+		_memoryManager->UpdateCpuClockHook();
+	}
 }
 
 void Console::RequestReset()
 {
-	Instance->_resetRequested = true;
+	GetCurrent()->_resetRequested = true;
 }
 
 uint32_t Console::GetLagCounter()
 {
-	return Instance->_lagCounter;
+	return GetCurrent()->_lagCounter;
 }
 
 void Console::ResetLagCounter()
 {
-	Instance->_lagCounter = 0;
+	GetCurrent()->_lagCounter = 0;
 }
 
 bool Console::IsDebuggerAttached()
 {
-	return (bool)Instance->_debugger;
+	return (bool)GetCurrent()->_debugger;
 }
 
 void Console::SetNextFrameOverclockStatus(bool disabled)
 {
-	Instance->_disableOcNextFrame = disabled;
+	GetCurrent()->_disableOcNextFrame = disabled;
 }
 
 HdPackData* Console::GetHdData()
 {
-	return Instance->_hdData.get();
+	return GetCurrent()->_hdData.get();
 }
 
 bool Console::IsHdPpu()
 {
-	return Instance->_hdData && std::dynamic_pointer_cast<HdPpu>(Instance->_ppu) != nullptr;
+	Console* console = GetCurrent();
+	return console->_hdData && std::dynamic_pointer_cast<HdPpu>(console->_ppu) != nullptr;
 }
 
 void Console::LoadHdPack(VirtualFile &romFile, VirtualFile &patchFile)
@@ -666,55 +900,61 @@ void Console::LoadHdPack(VirtualFile &romFile, VirtualFile &patchFile)
 
 void Console::StartRecordingHdPack(string saveFolder, ScaleFilterType filterType, uint32_t scale, uint32_t flags, uint32_t chrRamBankSize)
 {
+	Console* console = GetCurrent();
 	Console::Pause();
 	std::stringstream saveState;
-	Instance->SaveState(saveState);
+	console->SaveState(saveState);
 	
-	Instance->_hdPackBuilder.reset();
-	Instance->_hdPackBuilder.reset(new HdPackBuilder(saveFolder, filterType, scale, flags, chrRamBankSize, !Instance->_mapper->HasChrRom()));
+	console->_hdPackBuilder.reset();
+	console->_hdPackBuilder.reset(new HdPackBuilder(saveFolder, filterType, scale, flags, chrRamBankSize, !console->_mapper->HasChrRom()));
 
-	Instance->_memoryManager->UnregisterIODevice(Instance->_ppu.get());
-	Instance->_ppu.reset();
-	Instance->_ppu.reset(new HdBuilderPpu(Instance->_mapper.get(), Instance->_hdPackBuilder.get(), chrRamBankSize));
-	Instance->_memoryManager->RegisterIODevice(Instance->_ppu.get());
+	console->_memoryManager->UnregisterIODevice(console->_ppu.get());
+	console->_ppu.reset();
+	console->_ppu.reset(new HdBuilderPpu(console, console->_mapper.get(), console->_hdPackBuilder.get(), chrRamBankSize));
+	console->_memoryManager->RegisterIODevice(console->_ppu.get());
+	console->_cpu->SetPpu(console->_ppu.get());
 
-	Instance->LoadState(saveState);
+	console->LoadState(saveState);
 	Console::Resume();
 }
 
 std::shared_ptr<InstrumentingPpu> Console::Instrument()
 {
+	Console* console = GetCurrent();
 	Console::Pause();
 	std::stringstream saveState;
-	Instance->SaveState(saveState);
+	console->SaveState(saveState);
 	
-	Instance->_memoryManager->UnregisterIODevice(Instance->_ppu.get());
-	Instance->_ppu.reset();
-  auto ippu = new InstrumentingPpu(Instance->_mapper.get());
-	Instance->_ppu.reset(ippu);
-	Instance->_memoryManager->RegisterIODevice(Instance->_ppu.get());
-
-	Instance->LoadState(saveState);
+	console->_memoryManager->UnregisterIODevice(console->_ppu.get());
+	console->_ppu.reset();
+  auto ippu = new InstrumentingPpu(console, console->_mapper.get());
+	console->_ppu.reset(ippu);
+	console->_memoryManager->RegisterIODevice(console->_ppu.get());
+	console->_cpu->SetPpu(console->_ppu.get());
+
+	console->LoadState(saveState);
 	Console::Resume();
-  return std::dynamic_pointer_cast<InstrumentingPpu>(Instance->_ppu);
+  return std::dynamic_pointer_cast<InstrumentingPpu>(console->_ppu);
 }
 
 
 void Console::StopRecordingHdPack()
 {
-	if(Instance->_hdPackBuilder) {
+	Console* console = GetCurrent();
+	if(console->_hdPackBuilder) {
 		Console::Pause();
 		std::stringstream saveState;
-		Instance->SaveState(saveState);
+		console->SaveState(saveState);
 
-		Instance->_memoryManager->UnregisterIODevice(Instance->_ppu.get());
-		Instance->_ppu.reset();
-		Instance->_ppu.reset(new PPU(Instance->_mapper.get()));
-		Instance->_memoryManager->RegisterIODevice(Instance->_ppu.get());
+		console->_memoryManager->UnregisterIODevice(console->_ppu.get());
+		console->_ppu.reset();
+		console->_ppu.reset(new PPU(console, console->_mapper.get()));
+		console->_memoryManager->RegisterIODevice(console->_ppu.get());
+		console->_cpu->SetPpu(console->_ppu.get());
 
-		Instance->_hdPackBuilder.reset();
+		console->_hdPackBuilder.reset();
 
-		Instance->LoadState(saveState);
+		console->LoadState(saveState);
 		Console::Resume();
 	}
 }
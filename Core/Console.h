@@ -3,6 +3,7 @@
 #include "stdafx.h"
 #include <atomic>
 #include "../Utilities/SimpleLock.h"
+#include "../Utilities/PauseLock.h"
 #include "VirtualFile.h"
 #include "RomData.h"
 
@@ -18,16 +19,22 @@ class AutoSaveManager;
 class HdPackBuilder;
 class HdAudioDevice;
 class InstrumentingPpu;
+class CheatManager;
 struct HdPackData;
 enum class NesModel;
 enum class ScaleFilterType;
 
-class Console
+class Console : public std::enable_shared_from_this<Console>
 {
 	private:
+		//Default console, used by the UI and by any thread that has no console bound to it
 		static shared_ptr<Console> Instance;
-		SimpleLock _pauseLock;
-		SimpleLock _runLock;
+
+		//Console bound to the calling thread by ConsoleBinding - takes precedence over Instance
+		thread_local static Console* _boundConsole;
+
+		//Held by the emulation thread while it runs, see Pause
+		PauseLock _pauseLock;
 		SimpleLock _stopLock;
 
 		shared_ptr<RewindManager> _rewindManager;
@@ -39,6 +46,7 @@ class Console
 		shared_ptr<BaseMapper> _mapper;
 		unique_ptr<ControlManager> _controlManager;
 		shared_ptr<MemoryManager> _memoryManager;
+		unique_ptr<CheatManager> _cheatManager;
 
 		unique_ptr<AutoSaveManager> _autoSaveManager;
 
@@ -59,6 +67,7 @@ class Console
 		atomic<uint32_t> _lagCounter;
 		
 		bool _initialized = false;
+		uint32_t _controllerRevision = 0;
 
 		void LoadHdPack(VirtualFile &romFile, VirtualFile &patchFile);
 
@@ -77,7 +86,8 @@ class Console
 		static void Reset(bool softReset = true);
 		static void PowerCycle();
 
-		//Used to pause the emu loop to perform thread-safe operations
+		//Used to pause the emu loop to perform thread-safe operations: returns once the emulation thread has stopped at the
+		//end of its current instruction (without spinning on either side)
 		static void Pause();
 
 		//Used to resume the emu loop after calling Pause()
@@ -85,11 +95,32 @@ class Console
 
 		std::shared_ptr<Debugger> GetDebugger(bool autoStart = true);
 		void StopDebugger();
+		void UpdateMemoryAccessMode();
+
+		//Makes the loaded mapper call its CPU clock/VRAM address hooks even if it doesn't enable them (for benchmarks)
+		void SetForceMapperHooks(bool force);
 
 		static void SaveState(ostream &saveStream);
 		static void LoadState(istream &loadStream);
 		static void LoadState(uint8_t *buffer, uint32_t bufferSize);
 
+		//Writes the state of the console into buffer (same format as SaveState) and returns its size, without any intermediate
+		//copies or allocations. Nothing is written past bufferSize: call it again with a larger buffer if the returned size is larger.
+		static uint32_t SaveStateTo(uint8_t *buffer, uint32_t bufferSize);
+
+		//Loads a state written by SaveStateTo or SaveState directly from buffer.
+		//Unlike LoadState, this does not stop movies or notify listeners. Returns false (without loading anything) if the state is incomplete.
+		static bool LoadStateFrom(uint8_t *buffer, uint32_t bufferSize);
+
+		//Delta states only contain the pages of the state that differ from a parent state (a full state from SaveStateTo).
+		//Layout: state size, parent size, one bit per StateDeltaPageSize-byte page (1 = changed), then the changed pages.
+		//The PPU's output buffers are left out: a state loaded from a delta has the parent's picture until the next frame is drawn.
+		//Same size convention as SaveStateTo: call it again with a larger buffer if the returned size is larger.
+		static uint32_t SaveStateDelta(uint8_t *parentState, uint32_t parentSize, uint8_t *buffer, uint32_t bufferSize);
+
+		//Loads a delta written by SaveStateDelta against the same parent state. Returns false if the delta doesn't match the parent.
+		static bool LoadStateDelta(uint8_t *parentState, uint32_t parentSize, uint8_t *delta, uint32_t deltaSize);
+
 		static bool LoadROM(VirtualFile romFile, VirtualFile patchFile = {});
 		static bool LoadROM(string romName, HashInfo hashInfo);
 		static VirtualFile GetRomPath();
@@ -120,5 +151,49 @@ class Console
 		static shared_ptr<Console> GetInstance();
 		static void Release();
 
+		//Returns the console the static API currently operates on (the bound console, or the default instance)
+		static Console* GetCurrent()
+		{
+			Console* console = _boundConsole;
+			return console ? console : Instance.get();
+		}
+
+		bool IsDefaultInstance() { return this == Instance.get(); }
+
+		CPU* GetCpu() { return _cpu.get(); }
+		PPU* GetPpu() { return _ppu.get(); }
+		APU* GetApu() { return _apu.get(); }
+		MemoryManager* GetMemoryManager() { return _memoryManager.get(); }
+		BaseMapper* GetMapper() { return _mapper.get(); }
+		ControlManager* GetControlManager() { return _controlManager.get(); }
+		CheatManager* GetCheatManager() { return _cheatManager.get(); }
+		Debugger* GetAttachedDebugger() { return _debugger.get(); }
+
     static void RunOneStep();
+
+	friend class ConsoleBinding;
+};
+
+//Binds a console to the calling thread for the lifetime of this object.
+//All static calls made on this thread (Console::, CPU::, PPU::, APU::, etc.) target the bound console,
+//which allows several independent consoles to run in the same process (on the same or on different threads).
+class ConsoleBinding
+{
+private:
+	Console* _previous;
+
+public:
+	ConsoleBinding(Console* console)
+	{
+		_previous = Console::_boundConsole;
+		Console::_boundConsole = console;
+	}
+
+	~ConsoleBinding()
+	{
+		Console::_boundConsole = _previous;
+	}
+
+	ConsoleBinding(const ConsoleBinding&) = delete;
+	ConsoleBinding& operator=(const ConsoleBinding&) = delete;
 };
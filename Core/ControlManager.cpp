@@ -12,7 +12,6 @@
 #include "IKeyManager.h"
 
 unique_ptr<IKeyManager> ControlManager::_keyManager = nullptr;
-shared_ptr<BaseControlDevice> ControlManager::_controlDevices[2] = { nullptr, nullptr };
 IGameBroadcaster* ControlManager::_gameBroadcaster = nullptr;
 MousePosition ControlManager::_mousePosition = { -1, -1 };
 
@@ -99,17 +98,18 @@ void ControlManager::BroadcastInput(uint8_t port, uint8_t state)
 
 shared_ptr<BaseControlDevice> ControlManager::GetControlDevice(uint8_t port)
 {
-	return ControlManager::_controlDevices[port];
+	ControlManager* controlManager = Console::GetCurrent()->GetControlManager();
+	return controlManager ? controlManager->_controlDevices[port] : nullptr;
 }
 
 void ControlManager::RegisterControlDevice(shared_ptr<BaseControlDevice> controlDevice, uint8_t port)
 {
-	ControlManager::_controlDevices[port] = controlDevice;
+	_controlDevices[port] = controlDevice;
 }
 
 void ControlManager::UnregisterControlDevice(uint8_t port)
 {
-	ControlManager::_controlDevices[port].reset();
+	_controlDevices[port].reset();
 }
 
 void ControlManager::RefreshAllPorts()
@@ -119,8 +119,8 @@ void ControlManager::RefreshAllPorts()
 	}
 
 	for(int i = 0; i < 2; i++) {
-		if(ControlManager::_controlDevices[i]) {
-			ControlManager::_controlDevices[i]->RefreshStateBuffer();
+		if(_controlDevices[i]) {
+			_controlDevices[i]->RefreshStateBuffer();
 		}
 	}
 }
@@ -161,7 +161,7 @@ void ControlManager::UpdateControlDevices()
 		}
 
 		if(device) {
-			ControlManager::RegisterControlDevice(device, i);
+			RegisterControlDevice(device, i);
 
 			if(fourScore) {
 				if(EmulationSettings::GetControllerType(i + 2) == ControllerType::StandardController) {
@@ -209,7 +209,7 @@ uint8_t ControlManager::GetPortValue(uint8_t port)
 		//Reload until strobe bit is set to off
 		RefreshAllPorts();
 	}
-	shared_ptr<BaseControlDevice> device = GetControlDevice(port);
+	shared_ptr<BaseControlDevice> device = _controlDevices[port];
 
 	//"In the NES and Famicom, the top three (or five) bits are not driven, and so retain the bits of the previous byte on the bus. 
 	//Usually this is the most significant byte of the address of the controller port - 0x40.
@@ -220,7 +220,7 @@ uint8_t ControlManager::GetPortValue(uint8_t port)
 		
 		if(port == 0 && EmulationSettings::GetConsoleType() == ConsoleType::Famicom) {
 			//Connect $4016.2 to the 2nd controller's microphone on Famicoms
-			shared_ptr<StandardController> controller = std::dynamic_pointer_cast<StandardController>(GetControlDevice(1));
+			shared_ptr<StandardController> controller = std::dynamic_pointer_cast<StandardController>(_controlDevices[1]);
 			if(controller && controller->IsMicrophoneActive()) {
 				value |= 0x04;
 			}
@@ -248,7 +248,7 @@ template<typename T>
 shared_ptr<T> ControlManager::GetExpansionDevice()
 {
 	shared_ptr<StandardController> controller;
-	controller = std::dynamic_pointer_cast<StandardController>(GetControlDevice(1));
+	controller = std::dynamic_pointer_cast<StandardController>(_controlDevices[1]);
 	if(controller) {
 		shared_ptr<T> expansionDevice;
 		expansionDevice = std::dynamic_pointer_cast<T>(controller->GetAdditionalController());
@@ -322,8 +322,8 @@ void ControlManager::StreamState(bool saving)
 		UpdateControlDevices();
 	}
 
-	SnapshotInfo device0{ GetControlDevice(0).get() };
-	SnapshotInfo device1{ GetControlDevice(1).get() };
+	SnapshotInfo device0{ _controlDevices[0].get() };
+	SnapshotInfo device1{ _controlDevices[1].get() };
 	Stream(device0, device1);
 }
 
@@ -21,7 +21,6 @@ class ControlManager : public Snapshotable, public IMemoryHandler
 {
 	private:
 		static unique_ptr<IKeyManager> _keyManager;
-		static shared_ptr<BaseControlDevice> _controlDevices[2];
 		static IGameBroadcaster* _gameBroadcaster;
 		static MousePosition _mousePosition;
 
@@ -34,10 +33,12 @@ class ControlManager : public Snapshotable, public IMemoryHandler
 
 		virtual shared_ptr<BaseControlDevice> GetZapper(uint8_t port);
 
-		static void RegisterControlDevice(shared_ptr<BaseControlDevice> controlDevice, uint8_t port);
+		void RegisterControlDevice(shared_ptr<BaseControlDevice> controlDevice, uint8_t port);
 		void UnregisterControlDevice(uint8_t port);
 
 	protected:
+		shared_ptr<BaseControlDevice> _controlDevices[2];
+
 		uint8_t GetPortValue(uint8_t port);
 		virtual void RefreshAllPorts();
 
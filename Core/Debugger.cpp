@@ -25,7 +25,10 @@
 #include "ScriptHost.h"
 #include "DebugHud.h"
 
-Debugger* Debugger::Instance = nullptr;
+Debugger* Debugger::GetInstance()
+{
+	return Console::GetCurrent()->GetAttachedDebugger();
+}
 const int Debugger::BreakpointTypeCount;
 string Debugger::_disassemblerOutput = "";
 
@@ -95,8 +98,6 @@ Debugger::Debugger(shared_ptr<Console> console, shared_ptr<CPU> cpu, shared_ptr<
 
 	_hasScript = false;
 	_nextScriptId = 0;
-
-	Debugger::Instance = this;
 }
 
 Debugger::~Debugger()
@@ -106,9 +107,6 @@ Debugger::~Debugger()
 	_stopFlag = true;
 
 	Console::Pause();
-	if(Debugger::Instance == this) {
-		Debugger::Instance = nullptr;
-	}
 	_breakLock.Acquire();
 	_breakLock.Release();
 	Console::Resume();
@@ -144,14 +142,15 @@ bool Debugger::CheckFlag(DebuggerFlags flag)
 
 bool Debugger::IsEnabled()
 {
-	return Debugger::Instance != nullptr;
+	return GetInstance() != nullptr;
 }
 
 void Debugger::BreakIfDebugging()
 {
-	if(Debugger::Instance != nullptr) {
-		Debugger::Instance->Step(1);
-		Debugger::Instance->SleepUntilResume();
+	Debugger* debugger = GetInstance();
+	if(debugger) {
+		debugger->Step(1);
+		debugger->SleepUntilResume();
 	}
 }
 
@@ -372,8 +371,9 @@ void Debugger::PrivateProcessInterrupt(uint16_t cpuAddr, uint16_t destCpuAddr, b
 
 void Debugger::ProcessInterrupt(uint16_t cpuAddr, uint16_t destCpuAddr, bool forNmi)
 {
-	if(Debugger::Instance) {
-		Debugger::Instance->PrivateProcessInterrupt(cpuAddr, destCpuAddr, forNmi);
+	Debugger* debugger = GetInstance();
+	if(debugger) {
+		debugger->PrivateProcessInterrupt(cpuAddr, destCpuAddr, forNmi);
 	}
 }
 
@@ -803,30 +803,46 @@ void Debugger::SetNextStatement(uint16_t addr)
 
 void Debugger::ProcessPpuCycle()
 {
-	if(Debugger::Instance) {
-		Debugger::Instance->PrivateProcessPpuCycle();
+	ProcessPpuCycle(GetInstance());
+}
+
+void Debugger::ProcessPpuCycle(Debugger* debugger)
+{
+	if(debugger) {
+		debugger->PrivateProcessPpuCycle();
 	}
 }
 
 bool Debugger::ProcessRamOperation(MemoryOperationType type, uint16_t &addr, uint8_t &value)
 {
-	if(Debugger::Instance) {
-		return Debugger::Instance->PrivateProcessRamOperation(type, addr, value);
+	Debugger* debugger = GetInstance();
+	if(debugger) {
+		return debugger->PrivateProcessRamOperation(type, addr, value);
 	}
 	return true;
 }
 
 void Debugger::ProcessVramReadOperation(MemoryOperationType type, uint16_t addr, uint8_t &value)
 {
-	if(Debugger::Instance) {
-		Debugger::Instance->PrivateProcessVramReadOperation(type, addr, value);
+	ProcessVramReadOperation(GetInstance(), type, addr, value);
+}
+
+void Debugger::ProcessVramReadOperation(Debugger* debugger, MemoryOperationType type, uint16_t addr, uint8_t &value)
+{
+	if(debugger) {
+		debugger->PrivateProcessVramReadOperation(type, addr, value);
 	}
 }
 
 void Debugger::ProcessVramWriteOperation(uint16_t addr, uint8_t &value)
 {
-	if(Debugger::Instance) {
-		Debugger::Instance->PrivateProcessVramWriteOperation(addr, value);
+	ProcessVramWriteOperation(GetInstance(), addr, value);
+}
+
+void Debugger::ProcessVramWriteOperation(Debugger* debugger, uint16_t addr, uint8_t &value)
+{
+	if(debugger) {
+		debugger->PrivateProcessVramWriteOperation(addr, value);
 	}
 }
 
@@ -931,10 +947,11 @@ void Debugger::SetPpuViewerScanlineCycle(int32_t scanline, int32_t cycle)
 
 void Debugger::SetLastFramePpuScroll(uint16_t addr, uint8_t xScroll, bool updateHorizontalScrollOnly)
 {
-	if(Debugger::Instance) {
-		Debugger::Instance->_ppuScrollX = ((addr & 0x1F) << 3) | xScroll | ((addr & 0x400) ? 0x100 : 0);
+	Debugger* debugger = GetInstance();
+	if(debugger) {
+		debugger->_ppuScrollX = ((addr & 0x1F) << 3) | xScroll | ((addr & 0x400) ? 0x100 : 0);
 		if(!updateHorizontalScrollOnly) {
-			Debugger::Instance->_ppuScrollY = (((addr & 0x3E0) >> 2) | ((addr & 0x7000) >> 12)) + ((addr & 0x800) ? 240 : 0);
+			debugger->_ppuScrollY = (((addr & 0x3E0) >> 2) | ((addr & 0x7000) >> 12)) + ((addr & 0x800) ? 240 : 0);
 		}
 	}
 }
@@ -1023,16 +1040,18 @@ int32_t Debugger::FindSubEntryPoint(uint16_t relativeAddress)
 
 bool Debugger::HasInputOverride(uint8_t port)
 {
-	if(Debugger::Instance) {
-		return Debugger::Instance->_inputOverride[port] != 0;
+	Debugger* debugger = GetInstance();
+	if(debugger) {
+		return debugger->_inputOverride[port] != 0;
 	}
 	return false;
 }
 
 uint32_t Debugger::GetInputOverride(uint8_t port)
 {
-	if(Debugger::Instance) {
-		return Debugger::Instance->_inputOverride[port];
+	Debugger* debugger = GetInstance();
+	if(debugger) {
+		return debugger->_inputOverride[port];
 	}
 	return 0;
 }
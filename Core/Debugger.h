@@ -33,7 +33,7 @@ class DebugHud;
 class Debugger
 {
 private:
-	static Debugger* Instance;
+	static Debugger* GetInstance();
 
 	const static int BreakpointTypeCount = 6;
 
@@ -197,6 +197,11 @@ public:
 	static void ProcessVramReadOperation(MemoryOperationType type, uint16_t addr, uint8_t &value);
 	static void ProcessVramWriteOperation(uint16_t addr, uint8_t &value);
 	static void ProcessPpuCycle();
+
+	//Same as above, for callers that already hold their console's debugger (nullptr when none is attached)
+	static void ProcessVramReadOperation(Debugger* debugger, MemoryOperationType type, uint16_t addr, uint8_t &value);
+	static void ProcessVramWriteOperation(Debugger* debugger, uint16_t addr, uint8_t &value);
+	static void ProcessPpuCycle(Debugger* debugger);
 	
 	static void SetLastFramePpuScroll(uint16_t addr, uint8_t xScroll, bool updateHorizontalScrollOnly);
 	uint32_t GetPpuScroll();
@@ -5,11 +5,8 @@
 #include "Console.h"
 #include "MemoryManager.h"
 
-DeltaModulationChannel *DeltaModulationChannel::Instance = nullptr;
-
 DeltaModulationChannel::DeltaModulationChannel(AudioChannel channel, SoundMixer *mixer, MemoryManager* memoryManager) : BaseApuChannel(channel, mixer)
 {
-	Instance = this;
 	_memoryManager = memoryManager;
 }
 
@@ -209,7 +206,7 @@ bool DeltaModulationChannel::NeedToRun()
 
 void DeltaModulationChannel::SetReadBuffer()
 {
-	Instance->FillReadBuffer();
+	APU::GetInstance()->_deltaModulationChannel->FillReadBuffer();
 }
 
 ApuDmcState DeltaModulationChannel::GetState()
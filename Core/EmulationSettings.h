@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cassert>
 #include "stdafx.h"
 #include "MessageManager.h"
 #include "GameClient.h"
@@ -74,6 +75,12 @@ enum EmulationFlags : uint64_t
 
 	IntegerFpsMode = 0x2000000000000,
 
+	FusedCpuCore = 0x4000000000000,
+
+	SkipIdleLoops = 0x8000000000000,
+
+	PrgDecodeCache = 0x10000000000000,
+
 	ForceMaxSpeed = 0x4000000000000000,	
 	ConsoleMode = 0x8000000000000000,
 };
@@ -461,7 +468,7 @@ private:
 
 	static Language _displayLanguage;
 
-	static bool _audioSettingsChanged;
+	static atomic<uint32_t> _audioSettingsRevision;
 	static uint32_t _audioLatency;
 	static double _channelVolume[11];
 	static double _channelPanning[11];
@@ -510,7 +517,7 @@ private:
 	static ExpansionPortDevice _expansionDevice;
 	static ControllerType _controllerTypes[4];
 	static KeyMappingSet _controllerKeys[4];
-	static bool _needControllerUpdate;
+	static atomic<uint32_t> _controllerRevision;
 	static uint32_t _zapperDetectionRadius;
 
 	static int32_t _nsfAutoDetectSilenceDelay;
@@ -530,7 +537,21 @@ private:
 	static SimpleLock _shortcutLock;
 	static SimpleLock _lock;
 
+	static atomic<bool> _readOnly;
+
 public:
+	//The settings are shared by every console in the process. While several consoles run on worker threads at the same time
+	//(remocon's BatchStep), they are marked read-only: the setters that emulation code can reach assert that nothing changes them
+	static void SetReadOnly(bool readOnly)
+	{
+		_readOnly = readOnly;
+	}
+
+	static bool IsReadOnly()
+	{
+		return _readOnly;
+	}
+
 	static uint32_t GetMesenVersion()
 	{
 		return (_versionMajor << 16) | (_versionMinor << 8) | _versionRevision;
@@ -544,6 +565,7 @@ public:
 	static void SetFlags(uint64_t flags)
 	{
 		if((_flags & flags) != flags) {
+			assert(!_readOnly);
 			//Need a lock to prevent flag changes from being ignored due to multithreaded access
 			LockHandler lock = _lock.AcquireSafe();
 			_flags |= flags;
@@ -568,6 +590,7 @@ public:
 	static void ClearFlags(uint64_t flags)
 	{
 		if((_flags & flags) != 0) {
+			assert(!_readOnly);
 			//Need a lock to prevent flag changes from being ignored due to multithreaded access
 			LockHandler lock = _lock.AcquireSafe();
 			_flags &= ~flags;
@@ -602,6 +625,7 @@ public:
 
 	static void SetNesModel(NesModel model)
 	{
+		assert(!_readOnly);
 		_model = model;
 	}
 
@@ -612,6 +636,7 @@ public:
 
 	static void SetPpuModel(PpuModel ppuModel)
 	{
+		assert(!_readOnly);
 		_ppuModel = ppuModel;
 		UpdateCurrentPalette();
 	}
@@ -646,7 +671,7 @@ public:
 	static void SetChannelPanning(AudioChannel channel, double panning)
 	{
 		_channelPanning[(int)channel] = panning;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static double GetBandGain(int band)
@@ -663,7 +688,7 @@ public:
 		if(band < (int)_bandGains.size()) {
 			_bandGains[band] = gain;
 		}
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 	
 	static vector<double> GetEqualizerBands()
@@ -681,13 +706,13 @@ public:
 	static void SetEqualizerFilterType(EqualizerFilterType filter)
 	{
 		_equalizerFilterType = filter;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static void SetSampleRate(uint32_t sampleRate)
 	{
 		_sampleRate = sampleRate;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static uint32_t GetSampleRate()
@@ -698,32 +723,32 @@ public:
 	static void SetAudioLatency(uint32_t msLatency)
 	{
 		_audioLatency = msLatency;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static void SetStereoFilter(StereoFilter stereoFilter)
 	{
 		_stereoFilter = stereoFilter;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static void SetStereoDelay(int32_t delay)
 	{
 		_stereoDelay = delay;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static void SetStereoPanningAngle(double angle)
 	{
 		_stereoAngle = angle;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static void SetReverbParameters(double strength, double delay)
 	{
 		_reverbStrength = strength;
 		_reverbDelay = delay;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static StereoFilter GetStereoFilter()
@@ -754,16 +779,19 @@ public:
 	static void SetCrossFeedRatio(uint32_t ratio)
 	{
 		_crossFeedRatio = ratio;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
-	static bool NeedAudioSettingsUpdate()
+	//Each sound mixer keeps track of the last audio settings revision it has applied
+	static bool NeedAudioSettingsUpdate(uint32_t &appliedRevision)
 	{
-		bool value = _audioSettingsChanged;
-		if(value) {
-			_audioSettingsChanged = false;
+		uint32_t revision = _audioSettingsRevision;
+		if(appliedRevision != revision) {
+			appliedRevision = revision;
+			return true;
+		} else {
+			return false;
 		}
-		return value;
 	}
 
 	static uint32_t GetCrossFeedRatio()
@@ -838,11 +866,12 @@ public:
 			_effectiveOverclockRate = _overclockRate;
 		}
 		_hasOverclock = _effectiveOverclockRate != 100;
-		_audioSettingsChanged = true;
+		_audioSettingsRevision++;
 	}
 
 	static void DisableOverclocking(bool disabled)
 	{
+		assert(!_readOnly || _disableOverclocking == disabled);
 		_disableOverclocking = disabled;
 		UpdateEffectiveOverclockRate();
 	}
@@ -870,6 +899,7 @@ public:
 	static void SetOverclockRate(uint32_t overclockRate, bool adjustApu)
 	{
 		if(_overclockRate != overclockRate || _overclockAdjustApu != adjustApu) {
+			assert(!_readOnly);
 			_overclockRate = overclockRate;
 			_overclockAdjustApu = adjustApu;
 
@@ -894,6 +924,7 @@ public:
 	static void SetPpuNmiConfig(uint32_t extraScanlinesBeforeNmi, uint32_t extraScanlinesAfterNmi)
 	{
 		if(_extraScanlinesBeforeNmi != extraScanlinesBeforeNmi || _extraScanlinesAfterNmi != extraScanlinesAfterNmi) {
+			assert(!_readOnly);
 			if(extraScanlinesBeforeNmi > 0 || extraScanlinesAfterNmi > 0) {
 				MessageManager::DisplayMessage("PPU", "ScanlineTimingWarning");
 			}
@@ -1048,8 +1079,9 @@ public:
 
 	static void SetExpansionDevice(ExpansionPortDevice expansionDevice)
 	{
+		assert(!_readOnly);
 		_expansionDevice = expansionDevice;
-		_needControllerUpdate = true;
+		_controllerRevision++;
 	}
 	
 	static ExpansionPortDevice GetExpansionDevice()
@@ -1059,8 +1091,9 @@ public:
 
 	static void SetConsoleType(ConsoleType type)
 	{
+		assert(!_readOnly);
 		_consoleType = type;
-		_needControllerUpdate = true;
+		_controllerRevision++;
 	}
 
 	static ConsoleType GetConsoleType()
@@ -1070,8 +1103,9 @@ public:
 
 	static void SetControllerType(uint8_t port, ControllerType type)
 	{
+		assert(!_readOnly);
 		_controllerTypes[port] = type;
-		_needControllerUpdate = true;
+		_controllerRevision++;
 	}
 
 	static ControllerType GetControllerType(uint8_t port)
@@ -1082,7 +1116,7 @@ public:
 	static void SetControllerKeys(uint8_t port, KeyMappingSet keyMappings)
 	{
 		_controllerKeys[port] = keyMappings;
-		_needControllerUpdate = true;
+		_controllerRevision++;
 	}
 
 	static KeyMappingSet GetControllerKeys(uint8_t port)
@@ -1131,10 +1165,12 @@ public:
 		return _shortcutSupersets[keySetIndex][(uint32_t)shortcut];
 	}
 
-	static bool NeedControllerUpdate()
+	//Each console keeps track of the last controller configuration revision it has applied
+	static bool NeedControllerUpdate(uint32_t &appliedRevision)
 	{
-		if(_needControllerUpdate) {
-			_needControllerUpdate = false;
+		uint32_t revision = _controllerRevision;
+		if(appliedRevision != revision) {
+			appliedRevision = revision;
 			return true;
 		} else {
 			return false;
@@ -4,7 +4,10 @@
 #include "FdsAudio.h"
 #include "MemoryManager.h"
 
-FDS* FDS::Instance = nullptr;
+FDS* FDS::GetInstance()
+{
+	return dynamic_cast<FDS*>(Console::GetCurrent()->GetMapper());
+}
 bool FDS::_disableAutoInsertDisk = false;
 
 void FDS::InitMapper()
@@ -139,6 +142,14 @@ uint8_t FDS::ReadRAM(uint16_t addr)
 	return BaseMapper::ReadRAM(addr);
 }
 
+void FDS::SetFastForward(bool enabled)
+{
+	//Emulation speed is shared by all consoles, leave it alone while several of them run at once (see EmulationSettings::SetReadOnly)
+	if(!EmulationSettings::IsReadOnly()) {
+		EmulationSettings::SetFlagState(EmulationFlags::ForceMaxSpeed, enabled);
+	}
+}
+
 void FDS::ProcessCpuClock()
 {
 	if(IsAutoInsertDiskEnabled()) {
@@ -147,31 +158,31 @@ void FDS::ProcessCpuClock()
 			//automatically ejecting the disk the next time $4032 is read
 			_autoDiskEjectCounter--;
 			if(_autoDiskEjectCounter) {
-				EmulationSettings::SetFlags(EmulationFlags::ForceMaxSpeed);
+				SetFastForward(true);
 			} else {
-				EmulationSettings::ClearFlags(EmulationFlags::ForceMaxSpeed);
+				SetFastForward(false);
 			}
 		}
 		if(_autoDiskSwitchCounter > 0) {
 			//After ejecting the disk, wait a bit before we insert a new one
 			_autoDiskSwitchCounter--;
-			EmulationSettings::SetFlags(EmulationFlags::ForceMaxSpeed);
+			SetFastForward(true);
 			if(_autoDiskSwitchCounter == 0) {
 				//Insert a disk (real disk/side will be selected when game executes $E445
 				InsertDisk(0);
-				EmulationSettings::ClearFlags(EmulationFlags::ForceMaxSpeed);
+				SetFastForward(false);
 			}
 		}
 	}
 
 	if(EmulationSettings::CheckFlag(EmulationFlags::FdsFastForwardOnLoad)) {
 		if(_scanningDisk || !_gameStarted) {
-			EmulationSettings::SetFlags(EmulationFlags::ForceMaxSpeed);
+			SetFastForward(true);
 		} else {
-			EmulationSettings::ClearFlags(EmulationFlags::ForceMaxSpeed);
+			SetFastForward(false);
 		}
 	} else {
-		EmulationSettings::ClearFlags(EmulationFlags::ForceMaxSpeed);
+		SetFastForward(false);
 	}
 
 	ClockIrq();
@@ -445,8 +456,6 @@ void FDS::StreamState(bool saving)
 
 FDS::FDS()
 {
-	FDS::Instance = this;
-
 	_audio.reset(new FdsAudio());
 }
 
@@ -454,10 +463,6 @@ FDS::~FDS()
 {
 	//Restore emulation speed to normal when closing
 	EmulationSettings::ClearFlags(EmulationFlags::ForceMaxSpeed);
-
-	if(FDS::Instance == this) {
-		FDS::Instance = nullptr;
-	}
 }
 
 void FDS::SaveBattery()
@@ -470,8 +475,9 @@ void FDS::SaveBattery()
 
 uint32_t FDS::GetSideCount()
 {
-	if(FDS::Instance) {
-		return (uint32_t)FDS::Instance->_fdsDiskSides.size();
+	FDS* fds = GetInstance();
+	if(fds) {
+		return (uint32_t)fds->_fdsDiskSides.size();
 	} else {
 		return 0;
 	}
@@ -479,10 +485,11 @@ uint32_t FDS::GetSideCount()
 
 void FDS::InsertDisk(uint32_t diskNumber)
 {
-	if(FDS::Instance) {
+	FDS* fds = GetInstance();
+	if(fds) {
 		Console::Pause();
-		FDS::Instance->_newDiskNumber = diskNumber;
-		FDS::Instance->_newDiskInsertDelay = FDS::DiskInsertDelay;
+		fds->_newDiskNumber = diskNumber;
+		fds->_newDiskInsertDelay = FDS::DiskInsertDelay;
 		Console::Resume();
 
 		MessageManager::SendNotification(ConsoleNotificationType::FdsDiskChanged);
@@ -491,16 +498,20 @@ void FDS::InsertDisk(uint32_t diskNumber)
 
 void FDS::InsertNextDisk()
 {
-	InsertDisk(((FDS::Instance->_diskNumber & 0xFE) + 2) % GetSideCount());
+	FDS* fds = GetInstance();
+	if(fds) {
+		InsertDisk(((fds->_diskNumber & 0xFE) + 2) % GetSideCount());
+	}
 }
 
 void FDS::SwitchDiskSide()
 {
-	if(FDS::Instance) {
+	FDS* fds = GetInstance();
+	if(fds) {
 		Console::Pause();
-		if(FDS::Instance->_newDiskInsertDelay == 0 && FDS::Instance->_diskNumber != NoDiskInserted) {
-			FDS::Instance->_newDiskNumber = (FDS::Instance->_diskNumber & 0x01) ? (FDS::Instance->_diskNumber & 0xFE) : (FDS::Instance->_diskNumber | 0x01);
-			FDS::Instance->_newDiskInsertDelay = FDS::DiskInsertDelay;
+		if(fds->_newDiskInsertDelay == 0 && fds->_diskNumber != NoDiskInserted) {
+			fds->_newDiskNumber = (fds->_diskNumber & 0x01) ? (fds->_diskNumber & 0xFE) : (fds->_diskNumber | 0x01);
+			fds->_newDiskInsertDelay = FDS::DiskInsertDelay;
 		}
 		Console::Resume();
 
@@ -510,10 +521,11 @@ void FDS::SwitchDiskSide()
 
 void FDS::EjectDisk()
 {
-	if(FDS::Instance) {
+	FDS* fds = GetInstance();
+	if(fds) {
 		Console::Pause();
-		FDS::Instance->_newDiskNumber = NoDiskInserted;
-		FDS::Instance->_newDiskInsertDelay = 0;
+		fds->_newDiskNumber = NoDiskInserted;
+		fds->_newDiskInsertDelay = 0;
 		Console::Resume();
 
 		MessageManager::SendNotification(ConsoleNotificationType::FdsDiskChanged);
@@ -16,7 +16,7 @@ private:
 	static const uint32_t DiskInsertDelay = 3600000; //approx 2 sec delay
 	static bool _disableAutoInsertDisk;
 
-	static FDS* Instance;
+	static FDS* GetInstance();
 
 	unique_ptr<FdsAudio> _audio;
 
@@ -80,6 +80,7 @@ protected:
 	uint16_t RegisterStartAddress() override { return 0x4020; }
 	uint16_t RegisterEndAddress() override { return 0x4092; }
 	bool AllowRegisterRead() override { return true; }
+	bool AllowDirectPrgReads() override { return false; }
 
 	void InitMapper() override;
 	void InitMapper(RomData &romData) override;
@@ -91,7 +92,10 @@ protected:
 
 	void ClockIrq();
 	
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override;
+	void SetFastForward(bool enabled);
 	void UpdateCrc(uint8_t value);
 
 	bool IsDiskInserted();
@@ -108,7 +108,7 @@ protected:
 	}
 
 public:
-	HdBuilderPpu(BaseMapper* mapper, HdPackBuilder* hdPackBuilder, uint32_t chrRamBankSize) : PPU(mapper)
+	HdBuilderPpu(Console* console, BaseMapper* mapper, HdPackBuilder* hdPackBuilder, uint32_t chrRamBankSize) : PPU(console, mapper)
 	{
 		_hdPackBuilder = hdPackBuilder;
 		_chrRamBankSize = chrRamBankSize;
@@ -34,6 +34,30 @@ struct HdTileKey
 		}
 	}
 
+	//64-bit hash of the tile's pixels and palette: unlike GetHashCode, it doesn't depend on where the tile is in CHR ROM,
+	//so the same tile gets the same id in every run (and ROM revision).  Never 0.
+	uint64_t GetContentId() const
+	{
+		uint64_t words[3] = {};
+		memcpy(words, TileData, sizeof(TileData));
+		words[2] = PaletteColors;
+
+		uint64_t result = sizeof(TileData) + sizeof(PaletteColors);
+		for(uint64_t word : words) {
+			word *= 0x87C37B91114253D5ULL;
+			word = (word << 31) | (word >> 33);
+			word *= 0x4CF5AD432745937FULL;
+			result ^= word;
+			result = ((result << 27) | (result >> 37)) * 5 + 0x52DCE729;
+		}
+		result ^= result >> 33;
+		result *= 0xFF51AFD7ED558CCDULL;
+		result ^= result >> 33;
+		result *= 0xC4CEB9FE1A85EC53ULL;
+		result ^= result >> 33;
+		return result ? result : 1;
+	}
+
 	size_t operator() (const HdTileKey &tile) const {
 		return tile.GetHashCode();
 	}
@@ -126,7 +126,7 @@ protected:
 	}
 
 public:
-	HdPpu(BaseMapper* mapper, uint32_t version) : PPU(mapper)
+	HdPpu(Console* console, BaseMapper* mapper, uint32_t version) : PPU(console, mapper)
 	{
 		_screenTileBuffers[0] = new HdPpuPixelInfo[256 * 240];
 		_screenTileBuffers[1] = new HdPpuPixelInfo[256 * 240];
@@ -143,12 +143,14 @@ public:
 
 	void SendFrame()
 	{
-		MessageManager::SendNotification(ConsoleNotificationType::PpuFrameDone, _currentOutputBuffer);
+		if(Console::GetCurrent()->IsDefaultInstance()) {
+			MessageManager::SendNotification(ConsoleNotificationType::PpuFrameDone, _currentOutputBuffer);
 
-		if(RewindManager::IsRewinding()) {
-			VideoDecoder::GetInstance()->UpdateFrameSync(_currentOutputBuffer, _screenTiles);
-		} else {
-			VideoDecoder::GetInstance()->UpdateFrame(_currentOutputBuffer, _screenTiles);
+			if(RewindManager::IsRewinding()) {
+				VideoDecoder::GetInstance()->UpdateFrameSync(_currentOutputBuffer, _screenTiles);
+			} else {
+				VideoDecoder::GetInstance()->UpdateFrame(_currentOutputBuffer, _screenTiles);
+			}
 		}
 
 		_currentOutputBuffer = (_currentOutputBuffer == _outputBuffers[0]) ? _outputBuffers[1] : _outputBuffers[0];
@@ -1,82 +1,174 @@
 #include "InstrumentingPPU.h"
-#include <assert.h>
 
 void InstrumentingPpu::DrawPixel()
 {
+  if(_skipRender && !_trackTilesWhenSkipping) {
+    PPU::DrawPixel();
+    return;
+  }
   if(_scanline <= 0 && _cycle <= 1) {
     //std::cerr << GetFrameCount() << " CLEAR\n";
     spritesThisFrame = 0;
+    memset(_spriteTable, 0, sizeof(_spriteTable));
+  }
+  if(_cycle == 1) {
+    _overscan = EmulationSettings::GetOverscanDimensions();
+    if(_scanline == 0) {
+      //The last frame's tiles were kept until now so its per-pixel data can still be read once it is done
+      frameTiles.swap(_nextFrameTiles);
+      _nextFrameTiles.clear();
+    }
   }
+  uint32_t x = _cycle - 1;
+  uint32_t pixel = (_scanline << 8) + x;
+  uint16_t tileIndex = NoTileIndex;
   if(IsRenderingEnabled() || ((_state.VideoRamAddr & 0x3F00) != 0x3F00)) {
 			_lastSprite = nullptr;
 			uint32_t color = GetPixelColor();
-			_currentOutputBuffer[(_scanline << 8) + _cycle - 1] = _paletteRAM[color & 0x03 ? color : 0];
-			uint32_t backgroundColor = 0;
-			if(_flags.BackgroundEnabled && _cycle > _minimumDrawBgCycle) {
-			 	backgroundColor = (((_state.LowBitShift << _state.XScroll) & 0x8000) >> 15) | (((_state.HighBitShift << _state.XScroll) & 0x8000) >> 14);
+			if(!_skipRender) {
+				_currentOutputBuffer[pixel] = _paletteRAM[color & 0x03 ? color : 0];
 			}
-			bool hasBgSprite = false;
-			if(_lastSprite && _flags.SpritesEnabled) {
-        if(backgroundColor == 0) {
-				 	for(uint8_t i = 0; i < _spriteCount; i++) {
-				 		if(_spriteTiles[i].BackgroundPriority) {
-				 			hasBgSprite = true;
-				 			break;
-				 		}
-				 	}
-        }
-
-				if(_lastSprite->AbsoluteTileAddr >= 0) {
-					sprite.TileIndex = (_isChrRam ? (_lastSprite->TileAddr & _chrRamIndexMask) : _lastSprite->AbsoluteTileAddr) / 16;
-					sprite.PaletteColors = ReadPaletteRAM(_lastSprite->PaletteOffset + 3) | (ReadPaletteRAM(_lastSprite->PaletteOffset + 2) << 8) | (ReadPaletteRAM(_lastSprite->PaletteOffset + 1) << 16) | 0xFF000000;
-					sprite.IsChrRamTile = _isChrRam; 
-					for(int i = 0; i < 16; i++) {
-						sprite.TileData[i] = _mapper->GetMemoryValue(DebugMemoryType::ChrRom, _lastSprite->AbsoluteTileAddr / 16 * 16 + i);
-					}
+			if(_lastSprite && _flags.SpritesEnabled && _lastSprite->AbsoluteTileAddr >= 0 && _lastSprite->InstrumentationIndex < frameTiles.size()) {
+        InstTileData &sprite = frameTiles[_lastSprite->InstrumentationIndex];
+        if(!sprite.InSpriteList) {
+          //Once per fetched sprite row, the first time it is visible
+          sprite.InSpriteList = true;
           uint8_t spriteY = _scanline - _lastSprite->OffsetY;
-          //spriteData.insert({sprite, _lastSprite->SpriteX, spriteY});
-          InstSpriteData thisSprite = {sprite, _lastSprite->SpriteX, spriteY};
-          bool found = false;
-          for(int i = 0; i < spritesThisFrame; i++) {
-            if(spriteData[i] == thisSprite) {
-              found = true;
-              break;
-            }
-          }
-          if(!found) {
-            spriteData[spritesThisFrame] = thisSprite;
-            spritesThisFrame++;
-            assert(spritesThisFrame < InstrumentingPpu::MaxSpritesPerFrame);
+          AddSprite({sprite.key, _lastSprite->SpriteX, spriteY}, _contentIds ? sprite.Hash : sprite.key.GetContentId());
+        }
+        if(!sprite.InTileSet && !IsInOverscan(x, _scanline)) {
+          sprite.InTileSet = true;
+          auto findResult = allSpriteTiles.find(sprite.key);
+          if(findResult == allSpriteTiles.end()) {
+            newSpriteTiles.push_back(sprite.key);
+            allSpriteTiles.insert(findResult, sprite.key);
           }
-					ProcessTile(_cycle - 1, _scanline, _lastSprite->AbsoluteTileAddr, sprite, _mapper, true, true);
-				}
+        }
 			}
 
 			if(_flags.BackgroundEnabled) {
 				TileInfo* lastTile = &((_state.XScroll + ((_cycle - 1) & 0x07) < 8) ? _previousTile : _currentTile);
-				if(lastTile->AbsoluteTileAddr >= 0) {
-					tile.TileIndex = (_isChrRam ? (lastTile->TileAddr & _chrRamIndexMask) : lastTile->AbsoluteTileAddr) / 16;
-					tile.PaletteColors = ReadPaletteRAM(lastTile->PaletteOffset + 3) | (ReadPaletteRAM(lastTile->PaletteOffset + 2) << 8) | (ReadPaletteRAM(lastTile->PaletteOffset + 1) << 16) | (ReadPaletteRAM(0) << 24);
-					tile.IsChrRamTile = _isChrRam;
-          //TODO: might need to change for tall sprites?
-					for(int i = 0; i < 16; i++) {
-						tile.TileData[i] = _mapper->GetMemoryValue(DebugMemoryType::ChrRom, lastTile->AbsoluteTileAddr / 16 * 16 + i);
-					}
-					ProcessTile(_cycle - 1, _scanline, lastTile->AbsoluteTileAddr, tile, _mapper, false, hasBgSprite);
+				if(lastTile->AbsoluteTileAddr >= 0 && lastTile->InstrumentationIndex < frameTiles.size()) {
+          tileIndex = lastTile->InstrumentationIndex;
+          InstTileData &tile = frameTiles[tileIndex];
+          tile.XScroll = _state.XScroll;
+          if(!tile.InTileSet && !IsInOverscan(x, _scanline)) {
+            tile.InTileSet = true;
+            auto findResult = allTiles.find(tile.key);
+            if(findResult == allTiles.end()) {
+              newTiles.push_back(tile.key);
+              allTiles.insert(findResult, tile.key);
+            }
+          }
 				}
 			}
-		} else {
+		} else if(!_skipRender) {
 			//"If the current VRAM address points in the range $3F00-$3FFF during forced blanking, the color indicated by this palette location will be shown on screen instead of the backdrop color."
-			_currentOutputBuffer[(_scanline << 8) + _cycle - 1] = _paletteRAM[_state.VideoRamAddr & 0x1F];
+			_currentOutputBuffer[pixel] = _paletteRAM[_state.VideoRamAddr & 0x1F];
 		}
+  tileIndices[pixel] = tileIndex;
 	}
 
+void InstrumentingPpu::AddSprite(const InstSpriteData &sprite, uint64_t contentId)
+{
+  static_assert(SpriteTableSize >= MaxSpritesPerFrame * 2 && (SpriteTableSize & (SpriteTableSize - 1)) == 0, "The sprite table must be a power of 2, at most half full");
+  uint64_t hash = (contentId ^ ((uint64_t)sprite.X << 8) ^ sprite.Y) * 0x9E3779B97F4A7C15ULL;
+  uint32_t slot = (uint32_t)(hash >> 32) & (SpriteTableSize - 1);
+  while(_spriteTable[slot]) {
+    if(spriteData[_spriteTable[slot] - 1] == sprite) {
+      return;
+    }
+    slot = (slot + 1) & (SpriteTableSize - 1);
+  }
+  if(spritesThisFrame >= MaxSpritesPerFrame) {
+    //Only with heavy sprite multiplexing: the rest of the frame's sprites are not listed
+    return;
+  }
+  spriteData[spritesThisFrame] = sprite;
+  spritesThisFrame++;
+  _spriteTable[slot] = (uint16_t)spritesThisFrame;
+}
+
+bool InstrumentingPpu::IsInOverscan(uint32_t x, uint32_t y)
+{
+  return x < _overscan.Left || y < _overscan.Top || (PPU::ScreenWidth - x - 1) < _overscan.Right || (PPU::ScreenHeight - y - 1) < _overscan.Bottom;
+}
+
+std::vector<InstTileData>& InstrumentingPpu::GetFetchTiles()
+{
+  if(_scanline != -1) {
+    return frameTiles;
+  }
+  if(_nextFrameTiles.empty()) {
+    memset(_lastColumnTile, 0xFF, sizeof(_lastColumnTile));
+  }
+  return _nextFrameTiles;
+}
+
+void InstrumentingPpu::ProcessTileFetch(TileInfo &tileInfo)
+{
+  tileInfo.InstrumentationIndex = NoTileIndex;
+  if(_skipRender && !_trackTilesWhenSkipping) {
+    return;
+  }
+  std::vector<InstTileData> &tiles = GetFetchTiles();
+  if(tileInfo.AbsoluteTileAddr < 0 || tiles.size() >= NoTileIndex) {
+    return;
+  }
+
+  InstTileData data = {};
+  HdPpuTileInfo &tile = data.key;
+  tile.TileIndex = (_isChrRam ? (tileInfo.TileAddr & _chrRamIndexMask) : tileInfo.AbsoluteTileAddr) / 16;
+  tile.PaletteColors = ReadPaletteRAM(tileInfo.PaletteOffset + 3) | (ReadPaletteRAM(tileInfo.PaletteOffset + 2) << 8) | (ReadPaletteRAM(tileInfo.PaletteOffset + 1) << 16) | (ReadPaletteRAM(0) << 24);
+  tile.IsChrRamTile = _isChrRam;
+  //TODO: might need to change for tall sprites?
+  LoadTileData(tile, tileInfo.AbsoluteTileAddr);
+
+  //The 2 fetches at the end of a scanline are the first 2 tiles of the next one
+  uint32_t column = _cycle > 320 ? (_cycle - 321) / 8 : (_cycle - 1) / 8 + 2;
+  uint16_t &lastTile = _lastColumnTile[column];
+  if(lastTile < tiles.size() && tiles[lastTile].key == tile) {
+    //Same tile as the previous scanline: keep its hash, and whether it is already in allTiles
+    data = tiles[lastTile];
+  } else {
+    data.Hash = GetTileId(tile);
+  }
+  data.XScroll = _state.XScroll;
+  data.YScroll = tileInfo.OffsetY;
+  lastTile = (uint16_t)tiles.size();
+
+  tileInfo.InstrumentationIndex = (uint16_t)tiles.size();
+  tiles.push_back(data);
+}
+
+void InstrumentingPpu::ProcessSpriteTileFetch(SpriteInfo &spriteInfo)
+{
+  spriteInfo.InstrumentationIndex = NoTileIndex;
+  if(_skipRender && !_trackTilesWhenSkipping) {
+    return;
+  }
+  std::vector<InstTileData> &tiles = GetFetchTiles();
+  if(spriteInfo.AbsoluteTileAddr < 0 || tiles.size() >= NoTileIndex) {
+    return;
+  }
+
+  InstTileData data = {};
+  HdPpuTileInfo &sprite = data.key;
+  sprite.TileIndex = (_isChrRam ? (spriteInfo.TileAddr & _chrRamIndexMask) : spriteInfo.AbsoluteTileAddr) / 16;
+  sprite.PaletteColors = ReadPaletteRAM(spriteInfo.PaletteOffset + 3) | (ReadPaletteRAM(spriteInfo.PaletteOffset + 2) << 8) | (ReadPaletteRAM(spriteInfo.PaletteOffset + 1) << 16) | 0xFF000000;
+  sprite.IsChrRamTile = _isChrRam;
+  LoadTileData(sprite, spriteInfo.AbsoluteTileAddr);
+  data.Hash = GetTileId(sprite);
+
+  spriteInfo.InstrumentationIndex = (uint16_t)tiles.size();
+  tiles.push_back(data);
+}
 
-void InstrumentingPpu::ProcessTile(uint32_t x, uint32_t y, uint16_t tileAddr, HdPpuTileInfo &tile, BaseMapper *mapper, bool isSprite, bool transparencyRequired)
+void InstrumentingPpu::LoadTileData(HdPpuTileInfo &tile, int32_t absoluteTileAddr)
   {
-    HdTileKey dummy;
-    dummy.TileIndex = HdTileKey::NoTile;
-    tileData[y*PPU::ScreenWidth+x] = {dummy, 0, 0};
+    for(int i = 0; i < 16; i++) {
+      tile.TileData[i] = _mapper->GetMemoryValue(DebugMemoryType::ChrRom, absoluteTileAddr / 16 * 16 + i);
+    }
     if(tile.HorizontalMirroring) {
       //tiledata is 16 bytes, 2 per row.
       //to horizontally mirror, we flip each 2-bit pair in each byte and flip the two bytes in each row
@@ -110,34 +202,6 @@ void InstrumentingPpu::ProcessTile(uint32_t x, uint32_t y, uint16_t tileAddr, Hd
         tile.TileData[offB+1] = temp2;
       }
     }
-
-    if(!isSprite) {
-      tileData[y*PPU::ScreenWidth+x] = {
-        tile,
-        _state.XScroll,
-        tile.OffsetY
-      };
-    }
-
-    OverscanDimensions overscan = EmulationSettings::GetOverscanDimensions();
-    if(x < overscan.Left || y < overscan.Top || (PPU::ScreenWidth - x - 1) < overscan.Right || (PPU::ScreenHeight - y - 1) < overscan.Bottom) {
-      //Ignore tiles inside overscan
-      return;
-    }
-
-    if(isSprite) {
-      auto findResult = allSpriteTiles.find(tile);
-      if(findResult == allSpriteTiles.end()) {
-        newSpriteTiles.push_back(tile);
-        allSpriteTiles.insert(findResult, tile);
-      }
-    } else {
-      auto findResult = allTiles.find(tile);
-      if(findResult == allTiles.end()) {
-        newTiles.push_back(tile);
-        allTiles.insert(findResult, tile);
-      }
-    }
   }
 
 void InstrumentingPpu::ResetNewTiles() {
@@ -35,11 +35,26 @@ namespace std {
 
 
 struct InstPixelData {
-  HdTileKey key;
+  // See InstrumentingPpu::GetTileId
+  uint64_t Hash;
   uint8_t XScroll;
   uint8_t YScroll;
 };
 
+// One entry per tile fetch in the current frame
+struct InstTileData {
+  // Mirroring is already applied to key.TileData
+  HdPpuTileInfo key;
+  // GetTileId(key), computed once per fetch
+  uint64_t Hash;
+  uint8_t XScroll;
+  uint8_t YScroll;
+  // Set once the tile was drawn outside of the overscan area (and added to allTiles/allSpriteTiles)
+  bool InTileSet;
+  // Sprites only: set once the sprite was drawn (and added to spriteData)
+  bool InSpriteList;
+};
+
 class InstrumentingPpu : public PPU
 {
 private:
@@ -47,15 +62,46 @@ private:
 	bool _isChrRam;
   //size_t _chrRamBankSize = 4*0x400;
   size_t _chrRamIndexMask = 4*0x400-1;
+  OverscanDimensions _overscan;
+
+  bool _contentIds = false;
+  // See SetTrackTilesWhenSkipping
+  bool _trackTilesWhenSkipping = false;
+  InstPixelData _noTilePixel;
+  // frameTiles index of the previous fetch for each of the 34 background fetches of a scanline:
+  // a tile is usually fetched on 8 scanlines in a row, those fetches reuse the first one's data
+  uint16_t _lastColumnTile[34];
+  // Tiles fetched on the pre-render scanline are the first ones of the next frame, they become frameTiles once it starts
+  std::vector<InstTileData> _nextFrameTiles;
+
+  // Open addressing table over spriteData (index + 1, 0 = empty slot), keyed by the sprite's content id and position.
+  // Twice as many slots as sprites, so it never fills up
+  static const uint32_t SpriteTableSize = 2048;
+  uint16_t _spriteTable[SpriteTableSize];
+
+  std::vector<InstTileData>& GetFetchTiles();
+  void LoadTileData(HdPpuTileInfo &tile, int32_t absoluteTileAddr);
+  // Adds the sprite to spriteData unless it is already there (or the list is full)
+  void AddSprite(const InstSpriteData &sprite, uint64_t contentId);
+  bool IsInOverscan(uint32_t x, uint32_t y);
 
 protected:
   void DrawPixel();
-  void ProcessTile(uint32_t x, uint32_t y, uint16_t tileAddr, HdPpuTileInfo &tile, BaseMapper *mapper, bool isSprite, bool transparencyRequired);
+  void ProcessTileFetch(TileInfo &tile) override;
+  void ProcessSpriteTileFetch(SpriteInfo &sprite) override;
 
 public:
-  InstrumentingPpu(BaseMapper* mapper) : PPU(mapper)
+  static const uint16_t NoTileIndex = 0xFFFF;
+
+  InstrumentingPpu(Console* console, BaseMapper* mapper) : PPU(console, mapper)
 	{
 		_isChrRam = !_mapper->HasChrRom();
+    SetContentIds(false);
+    memset(tileIndices, 0xFF, sizeof(tileIndices));
+    memset(_lastColumnTile, 0xFF, sizeof(_lastColumnTile));
+    memset(_spriteTable, 0, sizeof(_spriteTable));
+    frameTiles.reserve(0x4000);
+    _nextFrameTiles.reserve(0x4000);
 	}
 
 	void SendFrame()
@@ -75,6 +121,30 @@ public:
     TriggerNmi();
   }
 
+  // Tile ids are GetHashCode() by default, or 64-bit HdTileKey::GetContentId() (stable across runs) once enabled.
+  // With content ids, pixels without a tile have id 0
+  void SetContentIds(bool contentIds)
+  {
+    _contentIds = contentIds;
+    HdTileKey noTile = {};
+    noTile.TileIndex = HdTileKey::NoTile;
+    _noTilePixel = { contentIds ? 0 : noTile.GetHashCode(), 0, 0 };
+  }
+
+  // In logic-only mode (PPU::SetSkipRender), tile fetches and the allTiles/newTiles bookkeeping are skipped by default
+  // along with the drawing: the aggregate info then only covers the frames that were rendered, and a tile first seen in
+  // a skipped frame becomes new in the first rendered frame that shows it.  With this set they keep running (only the
+  // output buffer is left alone), at about the cost of a rendered frame
+  void SetTrackTilesWhenSkipping(bool track)
+  {
+    _trackTilesWhenSkipping = track;
+  }
+
+  uint64_t GetTileId(const HdTileKey &tile) const
+  {
+    return _contentIds ? tile.GetContentId() : tile.GetHashCode();
+  }
+
   // Aggregate info
   std::unordered_set<HdTileKey> allTiles;
   std::unordered_set<HdTileKey> allSpriteTiles;
@@ -84,13 +154,23 @@ public:
   void ResetNewSpriteTiles();
 
   // Per-frame info
-  HdPpuTileInfo tile, sprite;
-  InstPixelData tileData[PPU::PixelCount];
-  static const size_t MaxSpritesPerFrame = 1024;
+  // Every tile fetched this frame, tileIndices has the index of the background tile drawn at each pixel (or NoTileIndex)
+  std::vector<InstTileData> frameTiles;
+  uint16_t tileIndices[PPU::PixelCount];
+  static const uint32_t MaxSpritesPerFrame = 1024;
   InstSpriteData spriteData[MaxSpritesPerFrame];
-  int spritesThisFrame;
+  uint32_t spritesThisFrame = 0;
+
+  InstPixelData GetPixelData(uint32_t pixel) {
+    uint16_t index = tileIndices[pixel];
+    if(index >= frameTiles.size()) {
+      return _noTilePixel;
+    }
+    const InstTileData &tile = frameTiles[index];
+    return { tile.Hash, tile.XScroll, tile.YScroll };
+  }
 
-  size_t GetSpriteCount() {
+  uint32_t GetSpriteCount() {
     // std::cerr << "SDS " << spritesThisFrame << "\n";
     return spritesThisFrame;
   }
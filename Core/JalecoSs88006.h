@@ -72,6 +72,8 @@ class JalecoSs88006 : public BaseMapper
 			SelectCHRPage(bankNumber, _chrBanks[bankNumber]);
 		}
 
+		virtual bool EnableCpuClockHook() override { return true; }
+
 		virtual void ProcessCpuClock() override
 		{
 			//Clock irq counter every memory read/write (each cpu cycle either reads or writes memory)
@@ -56,6 +56,7 @@ protected:
 	virtual uint16_t GetPRGPageSize() override { return 0x2000; }
 	virtual uint16_t GetCHRPageSize() override { return 0x0400; }
 	virtual bool AllowRegisterRead() override { return true; }
+	virtual bool RequiresPpuSync() override { return true; }
 
 	void InitMapper() override
 	{
@@ -337,6 +338,8 @@ protected:
 		UpdateState();
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqSource == JyIrqSource::CpuClock || (_irqSource == JyIrqSource::CpuWrite && CPU::IsCpuWrite())) {
@@ -352,6 +355,8 @@ protected:
 		return BaseMapper::MapperReadVRAM(addr, type);
 	}
 
+	virtual bool EnableVramAddressHook() override { return true; }
+
 	void NotifyVRAMAddressChange(uint16_t addr) override
 	{
 		if(_irqSource == JyIrqSource::PpuA12Rise && (addr & 0x1000) && !(_lastPpuAddr & 0x1000)) {
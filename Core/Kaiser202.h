@@ -35,6 +35,8 @@ protected:
 		}
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqEnabled) {
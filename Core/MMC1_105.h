@@ -24,6 +24,8 @@ protected:
 		Stream(_initState, _irqCounter, _irqEnabled);
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqEnabled) {
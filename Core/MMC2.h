@@ -83,6 +83,8 @@ class MMC2 : public BaseMapper
 		}
 
 	public:
+		virtual bool EnableVramAddressHook() override { return true; }
+
 		virtual void NotifyVRAMAddressChange(uint16_t addr) override
 		{
 			if(_needChrUpdate) {
@@ -192,6 +192,9 @@ class MMC3 : public BaseMapper
 
 		virtual uint16_t GetPRGPageSize() override { return 0x2000; }
 		virtual uint16_t GetCHRPageSize() override {	return 0x0400; }
+		//The A12 counter keeps running with IRQs disabled, but it is only clocked by the PPU and its registers are write-only:
+		//the PPU can lag behind until IRQs are enabled
+		virtual bool RequiresPpuSync() override { return _irqEnabled || _needIrq; }
 		virtual uint32_t GetSaveRamPageSize() override { return _subMapperID == 1 ? 0x200 : 0x2000; }
 		virtual uint32_t GetSaveRamSize() override { return _subMapperID == 1 ? 0x400 : 0x2000; }
 
@@ -268,9 +271,11 @@ class MMC3 : public BaseMapper
 
 
 	public:
+		virtual bool EnableVramAddressHook() override { return true; }
+
 		virtual void NotifyVRAMAddressChange(uint16_t addr) override
 		{
-			switch(_a12Watcher.UpdateVramAddress(addr)) {
+			switch(_a12Watcher.UpdateVramAddress(addr, _console->GetPpu()->GetFrameCycle())) {
 				case A12StateChange::Fall:
 					if(_needIrq) {
 						//Used by MC-ACC (Acclaim copy of the MMC3), see TriggerIrq above
@@ -35,6 +35,8 @@ protected:
 		_needUpdate = false;
 	}
 
+	virtual bool EnableVramAddressHook() override { return true; }
+
 	virtual void NotifyVRAMAddressChange(uint16_t addr) override
 	{
 		if(_needUpdate) {
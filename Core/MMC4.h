@@ -24,6 +24,8 @@ class MMC4 : public MMC2
 		}
 		
 	public:
+		virtual bool EnableVramAddressHook() override { return true; }
+
 		virtual void NotifyVRAMAddressChange(uint16_t addr) override
 		{
 			if(_needChrUpdate) {
@@ -180,11 +180,15 @@ private:
 		}
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		_audio.Clock();
 	}
 
+	virtual bool EnableVramAddressHook() override { return true; }
+
 	virtual void NotifyVRAMAddressChange(uint16_t addr) override
 	{
 		if(PPU::GetControlFlags().BackgroundEnabled || PPU::GetControlFlags().SpritesEnabled) {
@@ -268,6 +272,7 @@ private:
 protected:
 	virtual uint16_t GetPRGPageSize() override { return 0x2000; }
 	virtual uint16_t GetCHRPageSize() override {	return 0x400; }
+	virtual bool RequiresPpuSync() override { return true; }
 	virtual uint16_t RegisterStartAddress() override { return 0x5000; }
 	virtual uint16_t RegisterEndAddress() override { return 0x5206; }
 	virtual uint32_t GetSaveRamSize() override { return 0x10000; } //Emulate as if a single 64k block of saved ram existed
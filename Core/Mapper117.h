@@ -15,6 +15,7 @@ private:
 protected:
 	virtual uint16_t GetPRGPageSize() override { return 0x2000; }
 	virtual uint16_t GetCHRPageSize() override { return 0x400; }
+	virtual bool RequiresPpuSync() override { return true; }
 
 	void InitMapper() override
 	{
@@ -33,9 +34,11 @@ protected:
 		Stream(_irqCounter, _irqEnabled, _irqEnabledAlt, _irqReloadValue, a12Watcher);
 	}
 
+	virtual bool EnableVramAddressHook() override { return true; }
+
 	void NotifyVRAMAddressChange(uint16_t addr) override
 	{
-		if(_a12Watcher.UpdateVramAddress(addr) == A12StateChange::Rise) {
+		if(_a12Watcher.UpdateVramAddress(addr, _console->GetPpu()->GetFrameCycle()) == A12StateChange::Rise) {
 			if(_irqEnabled && _irqEnabledAlt && _irqCounter) {
 				_irqCounter--;
 				if(_irqCounter == 0) {
@@ -78,6 +78,8 @@ protected:
 		}
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	virtual void ProcessCpuClock() override
 	{
 		if(_needIrq) {
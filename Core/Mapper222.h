@@ -13,6 +13,7 @@ private:
 protected:
 	virtual uint16_t GetPRGPageSize() override { return 0x2000; }
 	virtual uint16_t GetCHRPageSize() override { return 0x400; }
+	virtual bool RequiresPpuSync() override { return true; }
 
 	void InitMapper() override
 	{
@@ -28,9 +29,11 @@ protected:
 		Stream(_irqCounter, a12Watcher);
 	}
 
+	virtual bool EnableVramAddressHook() override { return true; }
+
 	virtual void NotifyVRAMAddressChange(uint16_t addr) override
 	{
-		if(_a12Watcher.UpdateVramAddress(addr) == A12StateChange::Rise) {
+		if(_a12Watcher.UpdateVramAddress(addr, _console->GetPpu()->GetFrameCycle()) == A12StateChange::Rise) {
 			if(_irqCounter) {
 				_irqCounter++;
 				if(_irqCounter >= 240) {
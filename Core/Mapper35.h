@@ -14,6 +14,7 @@ private:
 protected:
 	virtual uint16_t GetPRGPageSize() override { return 0x2000; }
 	virtual uint16_t GetCHRPageSize() override { return 0x0400; }
+	virtual bool RequiresPpuSync() override { return true; }
 
 	void InitMapper() override
 	{
@@ -56,10 +57,12 @@ protected:
 		}
 	}
 	
+	virtual bool EnableVramAddressHook() override { return true; }
+
 	virtual void NotifyVRAMAddressChange(uint16_t addr) override
 	{
 		//MMC3-style A12 IRQ counter
-		if(_a12Watcher.UpdateVramAddress(addr) == A12StateChange::Rise) {
+		if(_a12Watcher.UpdateVramAddress(addr, _console->GetPpu()->GetFrameCycle()) == A12StateChange::Rise) {
 			if(_irqEnabled) {
 				_irqCounter--;
 				if(_irqCounter == 0) {
@@ -30,6 +30,8 @@ protected:
 		Stream(_irqCounter);
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqCounter > 0) {
@@ -31,6 +31,8 @@ protected:
 		Stream(_irqCounter, _irqEnabled);
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqEnabled) {
@@ -3,14 +3,14 @@
 #include "BaseMapper.h"
 #include "Debugger.h"
 #include "CheatManager.h"
-
-//Used for open bus
-uint8_t MemoryManager::_lastReadValue = 0;
+#include "Console.h"
+#include "CPU.h"
 
 MemoryManager::MemoryManager(shared_ptr<BaseMapper> mapper)
 {
 	_mapper = mapper;
 	_lastReadValue = 0;
+	_accessMode = MemoryAccessMode::Plain;
 
 	_internalRAM = new uint8_t[InternalRAMSize];
 	for(int i = 0; i < 2; i++) {
@@ -25,6 +25,13 @@ MemoryManager::MemoryManager(shared_ptr<BaseMapper> mapper)
 
 	memset(_ramReadHandlers, 0, RAMSize * sizeof(IMemoryHandler*));
 	memset(_ramWriteHandlers, 0, RAMSize * sizeof(IMemoryHandler*));
+
+	_prgReadPages = _mapper->GetPrgReadPages();
+	_prgRomReadOffsets = _mapper->GetPrgRomReadOffsets();
+	UpdateCpuClockHook();
+	for(int i = 0; i <= 0xFF; i++) {
+		UpdateMapperReadPage(i);
+	}
 }
 
 MemoryManager::~MemoryManager()
@@ -49,6 +56,8 @@ void MemoryManager::Reset(bool softReset)
 
 uint8_t MemoryManager::ReadRegister(uint16_t addr)
 {
+	//Registers and mappers can interact with the PPU, make sure it has caught up with the CPU
+	CPU::CatchUpPpu();
 	if(_ramReadHandlers[addr]) {
 		return _ramReadHandlers[addr]->ReadRAM(addr);
 	} else {
@@ -58,8 +67,13 @@ uint8_t MemoryManager::ReadRegister(uint16_t addr)
 
 void MemoryManager::WriteRegister(uint16_t addr, uint8_t value)
 {
+	CPU::CatchUpPpu();
 	if(_ramWriteHandlers[addr]) {
 		_ramWriteHandlers[addr]->WriteRAM(addr, value);
+		if(_ramWriteHandlers[addr] == _mapper.get()) {
+			//e.g MMC3 IRQs being enabled - the PPU can't lag behind anymore (see BaseMapper::RequiresPpuSync)
+			CPU::ResyncPpu();
+		}
 	}
 }
 
@@ -80,6 +94,7 @@ void MemoryManager::RegisterIODevice(IMemoryHandler *handler)
 
 	InitializeMemoryHandlers(_ramReadHandlers, handler, ranges.GetRAMReadAddresses(), ranges.GetAllowOverride());
 	InitializeMemoryHandlers(_ramWriteHandlers, handler, ranges.GetRAMWriteAddresses(), ranges.GetAllowOverride());
+	UpdateMapperReadPages(ranges.GetRAMReadAddresses());
 }
 
 void MemoryManager::UnregisterIODevice(IMemoryHandler *handler)
@@ -94,6 +109,33 @@ void MemoryManager::UnregisterIODevice(IMemoryHandler *handler)
 	for(uint16_t address : *ranges.GetRAMWriteAddresses()) {
 		_ramWriteHandlers[address] = nullptr;
 	}
+	UpdateMapperReadPages(ranges.GetRAMReadAddresses());
+}
+
+void MemoryManager::UpdateMapperReadPage(uint8_t page)
+{
+	//Let the mapper know whether it handles all reads in the page, it can only allow direct reads in those
+	bool owned = true;
+	for(int i = 0; i <= 0xFF; i++) {
+		if(_ramReadHandlers[(page << 8) | i] != _mapper.get()) {
+			owned = false;
+			break;
+		}
+	}
+	_mapper->SetOwnsCpuReadPage(page, owned);
+}
+
+void MemoryManager::UpdateMapperReadPages(vector<uint16_t> *addresses)
+{
+	//Only the pages the (un)registered read addresses are in can have changed owner
+	bool updated[0x100] = {};
+	for(uint16_t address : *addresses) {
+		uint8_t page = address >> 8;
+		if(!updated[page]) {
+			updated[page] = true;
+			UpdateMapperReadPage(page);
+		}
+	}
 }
 
 uint8_t* MemoryManager::GetInternalRAM()
@@ -132,32 +174,60 @@ uint16_t MemoryManager::DebugReadWord(uint16_t addr)
 	return DebugRead(addr) | (DebugRead(addr + 1) << 8);
 }
 
-void MemoryManager::ProcessCpuClock()
+void MemoryManager::UpdateCpuClockHook()
+{
+	_hasCpuClockHook = _mapper->HasCpuClockHook();
+}
+
+void MemoryManager::ProcessMapperCpuClock()
 {
 	_mapper->ProcessCpuClock();
 }
 
+void MemoryManager::SetAccessMode(MemoryAccessMode mode)
+{
+	//Release: the cheat codes/debugger the new mode uses are set up before the emulation thread can see it
+	_accessMode.store(mode, std::memory_order_release);
+}
+
+template<MemoryAccessMode mode>
 uint8_t MemoryManager::Read(uint16_t addr, MemoryOperationType operationType)
 {
 	uint8_t value;
 	if(addr <= 0x1FFF) {
 		value = _internalRAM[addr & 0x07FF];
+	} else if(_prgReadPages[addr >> 8]) {
+		value = _prgReadPages[addr >> 8][(uint8_t)addr];
 	} else {
 		value = ReadRegister(addr);
 	}
 
-	CheatManager::ApplyRamCodes(addr, value);
+	if(mode != MemoryAccessMode::Plain) {
+		CheatManager::ApplyRamCodes(addr, value);
+	}
 
-	Debugger::ProcessRamOperation(operationType, addr, value);
+	if(mode == MemoryAccessMode::Debug) {
+		Debugger::ProcessRamOperation(operationType, addr, value);
+	}
 
 	_lastReadValue = value;
 
 	return value;
 }
 
+uint8_t MemoryManager::Read(uint16_t addr, MemoryOperationType operationType)
+{
+	switch(_accessMode.load(std::memory_order_acquire)) {
+		case MemoryAccessMode::Plain: return Read<MemoryAccessMode::Plain>(addr, operationType);
+		case MemoryAccessMode::Cheats: return Read<MemoryAccessMode::Cheats>(addr, operationType);
+		default: return Read<MemoryAccessMode::Debug>(addr, operationType);
+	}
+}
+
+template<MemoryAccessMode mode>
 void MemoryManager::Write(uint16_t addr, uint8_t value)
 {
-	if(Debugger::ProcessRamOperation(MemoryOperationType::Write, addr, value)) {
+	if(mode != MemoryAccessMode::Debug || Debugger::ProcessRamOperation(MemoryOperationType::Write, addr, value)) {
 		if(addr <= 0x1FFF) {
 			_internalRAM[addr & 0x07FF] = value;
 		} else {
@@ -166,6 +236,16 @@ void MemoryManager::Write(uint16_t addr, uint8_t value)
 	}
 }
 
+void MemoryManager::Write(uint16_t addr, uint8_t value)
+{
+	//Cheats only apply to reads
+	if(_accessMode.load(std::memory_order_acquire) == MemoryAccessMode::Debug) {
+		Write<MemoryAccessMode::Debug>(addr, value);
+	} else {
+		Write<MemoryAccessMode::Plain>(addr, value);
+	}
+}
+
 void MemoryManager::DebugWrite(uint16_t addr, uint8_t value, bool disableSideEffects)
 {
 	if(addr <= 0x1FFF) {
@@ -190,6 +270,11 @@ uint32_t MemoryManager::ToAbsolutePrgAddress(uint16_t ramAddr)
 	return _mapper->ToAbsoluteAddress(ramAddr);
 }
 
+uint32_t MemoryManager::GetPrgRomSize()
+{
+	return _mapper->GetMemorySize(DebugMemoryType::PrgRom);
+}
+
 void MemoryManager::StreamState(bool saving)
 {
 	ArrayInfo<uint8_t> internalRam = { _internalRAM, MemoryManager::InternalRAMSize };
@@ -200,5 +285,5 @@ void MemoryManager::StreamState(bool saving)
 
 uint8_t MemoryManager::GetOpenBus(uint8_t mask)
 {
-	return _lastReadValue & mask;
+	return Console::GetCurrent()->GetMemoryManager()->_lastReadValue & mask;
 }
\ No newline at end of file
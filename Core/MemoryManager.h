@@ -6,6 +6,15 @@
 
 class BaseMapper;
 
+//Which hooks CPU reads/writes go through: Plain has none, Cheats applies RAM cheat codes, Debug also calls the debugger.
+//Set by Console::UpdateMemoryAccessMode whenever a debugger is attached/detached or cheats are changed.
+enum class MemoryAccessMode
+{
+	Plain = 0,
+	Cheats = 1,
+	Debug = 2
+};
+
 class MemoryManager: public Snapshotable
 {
 	private:
@@ -14,7 +23,8 @@ class MemoryManager: public Snapshotable
 		static const int VRAMSize = 0x4000;
 		static const int NameTableScreenSize = 0x400;
 
-		static uint8_t _lastReadValue;
+		//Used for open bus
+		uint8_t _lastReadValue = 0;
 
 		shared_ptr<BaseMapper> _mapper;
 
@@ -23,10 +33,25 @@ class MemoryManager: public Snapshotable
 
 		IMemoryHandler** _ramReadHandlers;
 		IMemoryHandler** _ramWriteHandlers;
+
+		//Owned by the mapper (see BaseMapper::GetPrgReadPages) - pages that can be read without going through the handlers
+		uint8_t** _prgReadPages;
+		//Owned by the mapper too (see BaseMapper::GetPrgRomReadOffsets)
+		int32_t* _prgRomReadOffsets;
+
+		//Written by whichever thread attaches the debugger or changes cheats, read by the emulation thread on every access
+		atomic<MemoryAccessMode> _accessMode;
+		bool _hasCpuClockHook = false;
 			
+		template<MemoryAccessMode mode> uint8_t Read(uint16_t addr, MemoryOperationType operationType);
+		template<MemoryAccessMode mode> void Write(uint16_t addr, uint8_t value);
+
 		uint8_t ReadRegister(uint16_t addr);
 		void WriteRegister(uint16_t addr, uint8_t value);
 		void InitializeMemoryHandlers(IMemoryHandler** memoryHandlers, IMemoryHandler* handler, vector<uint16_t> *addresses, bool allowOverride);
+		void UpdateMapperReadPage(uint8_t page);
+		void UpdateMapperReadPages(vector<uint16_t> *addresses);
+		void ProcessMapperCpuClock();
 
 	protected:
 		void StreamState(bool saving) override;
@@ -45,7 +70,42 @@ class MemoryManager: public Snapshotable
 
 		uint8_t* GetInternalRAM();
 
-		void ProcessCpuClock();
+		//Skips the virtual call for mappers that don't need to be clocked (see BaseMapper::EnableCpuClockHook)
+		__forceinline void ProcessCpuClock()
+		{
+			if(_hasCpuClockHook) {
+				ProcessMapperCpuClock();
+			}
+		}
+
+		//Reading a plain address (internal RAM, or a page the mapper maps for direct reads) has no side effects and gives the
+		//same value until the CPU writes to it.  PeekPlain reads one without updating the open bus.
+		bool IsPlainAddress(uint16_t addr) { return addr <= 0x1FFF || _prgReadPages[addr >> 8]; }
+		uint8_t PeekPlain(uint16_t addr) { return addr <= 0x1FFF ? _internalRAM[addr & 0x07FF] : _prgReadPages[addr >> 8][(uint8_t)addr]; }
+
+		//Page that can be read directly (plain internal RAM, or a page the mapper maps for direct reads), nullptr if none
+		uint8_t* GetPlainPage(uint8_t page) { return page <= 0x1F ? _internalRAM + ((page & 0x07) << 8) : _prgReadPages[page]; }
+
+		bool IsRegisterWriteHandler(uint16_t addr, IMemoryHandler* handler) { return _ramWriteHandlers[addr] == handler; }
+
+		//True when nothing but the CPU's own reads/writes can reach the mapper (no CPU clock hook), and those have no other
+		//side effects (Plain access, no debugger or cheats)
+		bool IsPlainCpuBus() { return !_hasCpuClockHook && _accessMode.load(std::memory_order_acquire) == MemoryAccessMode::Plain; }
+
+		//Offset of addr in the PRG ROM if it is read directly from a ROM that can't change, -1 otherwise (used by CPU's decode cache)
+		int32_t GetPrgRomReadOffset(uint16_t addr)
+		{
+			int32_t offset = _prgRomReadOffsets[addr >> 8];
+			return offset < 0 ? -1 : offset + (uint8_t)addr;
+		}
+
+		uint32_t GetPrgRomSize();
+
+		//Same effect on the open bus as a read that returned value
+		void SetLastReadValue(uint8_t value) { _lastReadValue = value; }
+
+		void SetAccessMode(MemoryAccessMode mode);
+		void UpdateCpuClockHook();
 
 		uint8_t Read(uint16_t addr, MemoryOperationType operationType = MemoryOperationType::Read);
 		void Write(uint16_t addr, uint8_t value);
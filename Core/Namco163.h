@@ -93,6 +93,8 @@ protected:
 		}
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqCounter & 0x8000 && (_irqCounter & 0x7FFF) != 0x7FFF) {
@@ -102,6 +102,8 @@ public:
 		return 4;
 	}
 
+	virtual bool EnableVramAddressHook() override { return true; }
+
 	virtual void NotifyVRAMAddressChange(uint16_t addr) override
 	{
 		if(_autoSwitchCHR && PPU::GetCurrentCycle() > 256) {
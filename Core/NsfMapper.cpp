@@ -5,11 +5,8 @@
 #include "Console.h"
 #include "MemoryManager.h"
 
-NsfMapper* NsfMapper::_instance;
-
 NsfMapper::NsfMapper()
 {
-	_instance = this;
 	EmulationSettings::DisableOverclocking(true);
 	EmulationSettings::ClearFlags(EmulationFlags::Paused);
 	EmulationSettings::SetFlags(EmulationFlags::NsfPlayerEnabled);
@@ -17,8 +14,9 @@ NsfMapper::NsfMapper()
 
 NsfMapper::~NsfMapper()
 {
-	if(_instance == this) {
-		_instance = nullptr;
+	//Only restore the settings if the console isn't switching to another NSF file
+	NsfMapper* current = GetInstance();
+	if(current == nullptr || current == this) {
 		EmulationSettings::DisableOverclocking(false);
 		EmulationSettings::ClearFlags(EmulationFlags::NsfPlayerEnabled);
 	}
@@ -26,7 +24,7 @@ NsfMapper::~NsfMapper()
 
 NsfMapper * NsfMapper::GetInstance()
 {
-	return _instance;
+	return dynamic_cast<NsfMapper*>(Console::GetCurrent()->GetMapper());
 }
 
 void NsfMapper::InitMapper()
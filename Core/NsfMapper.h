@@ -18,7 +18,6 @@ enum class NsfIrqType
 class NsfMapper : public BaseMapper
 {
 private:
-	static NsfMapper *_instance;
 
 	enum NsfSoundChips
 	{
@@ -110,6 +109,8 @@ protected:
 	void Reset(bool softReset) override;
 	void GetMemoryRanges(MemoryRanges &ranges) override;
 	
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override;
 	uint8_t ReadRegister(uint16_t addr) override;
 	void WriteRegister(uint16_t addr, uint8_t value) override;
@@ -15,7 +15,7 @@ protected:
 	}
 
 public:
-	NsfPpu(BaseMapper* mapper) : PPU(mapper)
+	NsfPpu(Console* console, BaseMapper* mapper) : PPU(console, mapper)
 	{
 
 	}
@@ -34,6 +34,8 @@ protected:
 		SelectCHRPage(1, _outerChrBank | 0x03);
 	}
 
+	virtual bool EnableVramAddressHook() override { return true; }
+
 	void NotifyVRAMAddressChange(uint16_t addr) override
 	{
 		if((_lastAddress & 0x3000) != 0x2000 && (addr & 0x3000) == 0x2000) {
@@ -8,14 +8,11 @@
 #include "BaseMapper.h"
 #include "RewindManager.h"
 
-PPU* PPU::Instance = nullptr;
-
-PPU::PPU(BaseMapper *mapper)
+PPU::PPU(Console *console, BaseMapper *mapper)
 {
-	PPU::Instance = this;
-
 	EmulationSettings::SetPpuModel(PpuModel::Ppu2C02);
 
+	_console = console;
 	_mapper = mapper;
 	_outputBuffers[0] = new uint16_t[256 * 240];
 	_outputBuffers[1] = new uint16_t[256 * 240];
@@ -74,7 +71,7 @@ void PPU::Reset()
 	_cyclesNeeded = 0.0;
 
 	memset(_hasSprite, 0, sizeof(_hasSprite));
-	memset(_spriteTiles, 0, sizeof(SpriteInfo));
+	memset(_spriteTiles, 0, sizeof(_spriteTiles));
 	_spriteCount = 0;
 	_secondaryOAMAddr = 0;
 	_sprite0Visible = false;
@@ -561,6 +558,7 @@ void PPU::LoadTileInfo()
 
 			case 5:
 				_nextTile.HighByte = _mapper->ReadVRAM(_nextTile.TileAddr + 8);
+				ProcessTileFetch(_nextTile);
 				break;
 		}
 	}
@@ -606,6 +604,7 @@ void PPU::LoadSprite(uint8_t spriteY, uint8_t tileIndex, uint8_t attributes, uin
 		info.AbsoluteTileAddr = _mapper->ToAbsoluteChrAddress(tileAddr);
 		info.OffsetY = lineOffset;
 		info.SpriteX = spriteX;
+		ProcessSpriteTileFetch(info);
 
 		if(_scanline >= 0) {
 			//Sprites read on prerender scanline are not shown on scanline 0
@@ -739,6 +738,14 @@ uint8_t PPU::GetPixelColor()
 void PPU::DrawPixel()
 {
 	//This is called 3.7 million times per second - needs to be as fast as possible.
+	if(_skipRender) {
+		//Sprite 0 hit is the only side effect of GetPixelColor, and it needs sprite 0 on this pixel and the background enabled
+		if(_hasSprite[_cycle] && _sprite0Visible && _flags.BackgroundEnabled && !_statusFlags.Sprite0Hit) {
+			GetPixelColor();
+		}
+		return;
+	}
+
 	if(IsRenderingEnabled() || ((_state.VideoRamAddr & 0x3F00) != 0x3F00)) {
 		uint32_t color = GetPixelColor();
 		_currentOutputBuffer[(_scanline << 8) + _cycle - 1] = _paletteRAM[color & 0x03 ? color : 0];
@@ -1004,23 +1011,41 @@ void PPU::WriteSpriteRam(uint8_t addr, uint8_t value)
 	}
 }
 
+void PPU::WriteSpriteRamPage(uint8_t* source)
+{
+	//The writes start at SpriteRamAddr and wrap around, which leaves SpriteRamAddr where it was
+	uint8_t start = _state.SpriteRamAddr;
+	memcpy(_spriteRAM + start, source, 0x100 - start);
+	memcpy(_spriteRAM, source + 0x100 - start, start);
+	for(int i = 2; i < 0x100; i += 4) {
+		//Same as in WriteRAM - the unimplemented bits of byte 2 always read back as 0
+		_spriteRAM[i] &= 0xE3;
+	}
+	SetOpenBus(0xFF, source[0xFF]);
+}
+
 void PPU::DebugSendFrame()
 {
-	VideoDecoder::GetInstance()->UpdateFrame(_currentOutputBuffer);
+	if(Console::GetCurrent()->IsDefaultInstance()) {
+		VideoDecoder::GetInstance()->UpdateFrame(_currentOutputBuffer);
+	}
 }
 
 void PPU::SendFrame()
 {
 	UpdateGrayscaleAndIntensifyBits();
 
- 	MessageManager::SendNotification(ConsoleNotificationType::PpuFrameDone, _currentOutputBuffer);
+	//Only the default console is connected to the video decoder and to the UI's frame listeners (rewind, movies, etc.)
+	if(Console::GetCurrent()->IsDefaultInstance()) {
+		MessageManager::SendNotification(ConsoleNotificationType::PpuFrameDone, _currentOutputBuffer);
 
-	if(RewindManager::IsRewinding()) {
-		if(!RewindManager::IsStepBack()) {
-			VideoDecoder::GetInstance()->UpdateFrameSync(_currentOutputBuffer);
+		if(RewindManager::IsRewinding()) {
+			if(!RewindManager::IsStepBack()) {
+				VideoDecoder::GetInstance()->UpdateFrameSync(_currentOutputBuffer);
+			}
+		} else {
+			VideoDecoder::GetInstance()->UpdateFrame(_currentOutputBuffer);
 		}
-	} else {
-		VideoDecoder::GetInstance()->UpdateFrame(_currentOutputBuffer);
 	}
 
 	//Switch output buffer.  VideoDecoder will decode the last frame while we build the new one.
@@ -1072,7 +1097,7 @@ void PPU::Exec()
 			UpdateMinimumDrawCycles();
 		}
 
-		Debugger::ProcessPpuCycle();
+		Debugger::ProcessPpuCycle(_console->GetAttachedDebugger());
 		
 		UpdateApuStatus();
 
@@ -1087,7 +1112,7 @@ void PPU::Exec()
 		//Cycle > 0
 		_cycle++;
 
-		Debugger::ProcessPpuCycle();
+		Debugger::ProcessPpuCycle(_console->GetAttachedDebugger());
 		if(_scanline < 240) {
 			ProcessScanline();
 		} else if(_nesModel == NesModel::PAL && _scanline >= _palSpriteEvalScanline) {
@@ -1119,33 +1144,79 @@ void PPU::Exec()
 	}
 }
 
-void PPU::ExecStatic()
+void PPU::RunStandardCpuCycle()
+{
+	Exec();
+	Exec();
+	Exec();
+	if(_ignoreVramRead) {
+		_ignoreVramRead--;
+	}
+}
+
+void PPU::ProcessCpuClock()
 {
 	if(!EmulationSettings::HasOverclock()) {
-		PPU::Instance->Exec();
-		PPU::Instance->Exec();
-		PPU::Instance->Exec();
-		if(PPU::Instance->_nesModel == NesModel::PAL && CPU::GetCycleCount() % 5 == 0) {
+		if(_nesModel != NesModel::PAL) {
+			RunStandardCpuCycle();
+			return;
+		}
+		Exec();
+		Exec();
+		Exec();
+		if(CPU::GetCycleCount() % 5 == 0) {
 			//PAL PPU runs 3.2 clocks for every CPU clock, so we need to run an extra clock every 5 CPU clocks
-			PPU::Instance->Exec();
+			Exec();
 		}
 	} else {
-		if(PPU::Instance->_nesModel == NesModel::PAL) {
+		if(_nesModel == NesModel::PAL) {
 			//PAL PPU runs 3.2 clocks for every CPU clock, so we need to run an extra clock every 5 CPU clocks
-			Instance->_cyclesNeeded += 3.2 / (EmulationSettings::GetOverclockRate() / 100.0);
+			_cyclesNeeded += 3.2 / (EmulationSettings::GetOverclockRate() / 100.0);
 		} else {
-			Instance->_cyclesNeeded += 3.0 / (EmulationSettings::GetOverclockRate() / 100.0);
+			_cyclesNeeded += 3.0 / (EmulationSettings::GetOverclockRate() / 100.0);
 		}
 
-		while(Instance->_cyclesNeeded >= 1.0) {
-			PPU::Instance->Exec();
-			Instance->_cyclesNeeded--;
+		while(_cyclesNeeded >= 1.0) {
+			Exec();
+			_cyclesNeeded--;
 		}
 	}
 
-	if(PPU::Instance->_ignoreVramRead) {
-		PPU::Instance->_ignoreVramRead--;
+	if(_ignoreVramRead) {
+		_ignoreVramRead--;
+	}
+}
+
+void PPU::CatchUp(uint32_t cpuCycles)
+{
+	//Only used when GetCatchUpWindow allows it, i.e when ProcessCpuClock would run RunStandardCpuCycle too
+	for(uint32_t i = 0; i < cpuCycles; i++) {
+		RunStandardCpuCycle();
+	}
+}
+
+int32_t PPU::GetCatchUpWindow()
+{
+	//Only when the PPU runs exactly 3 dots per CPU cycle and nothing needs to see it dot by dot as the CPU runs
+	//(the debugger, mappers that can trigger IRQs based on the PPU's bus right now, OAM decay which uses the CPU's cycle count)
+	if(_nesModel == NesModel::PAL || EmulationSettings::HasOverclock() || _console->GetAttachedDebugger() || _mapper->RequiresPpuSync() ||
+		_enableOamDecay || _nmiScanline != _standardNmiScanline || _vblankEnd != _standardVblankEnd) {
+		return -1;
 	}
+
+	//Number of Exec() calls before the one that moves to the given scanline, minus 1 in case the odd frame dot is skipped
+	int32_t scanlineCount = _vblankEnd + 2;
+	auto getDotsBefore = [=](int32_t scanline) {
+		int32_t lineCount = scanline - _scanline;
+		if(lineCount <= 0) {
+			lineCount += scanlineCount;
+		}
+		return (340 - (int32_t)_cycle) + (lineCount - 1) * 341 - 1;
+	};
+
+	//Vertical blank starts (NMI) / a new frame starts at the pre-render scanline
+	int32_t dots = std::min(getDotsBefore(_nmiScanline), getDotsBefore(_vblankEnd + 1));
+	return std::max(dots, 0) / 3;
 }
 
 void PPU::StreamState(bool saving)
@@ -1186,7 +1257,12 @@ void PPU::StreamState(bool saving)
   uint8_t is_first = (uint8_t)(_currentOutputBuffer == _outputBuffers[0]);
   ArrayInfo<uint8_t> ob0 = {(uint8_t*)(_outputBuffers[0]), PPU::OutputBufferSize};
   ArrayInfo<uint8_t> ob1 = {(uint8_t*)(_outputBuffers[1]), PPU::OutputBufferSize};
+  uint32_t outputBuffersStart = GetStreamPosition();
   Stream(ob0, ob1, is_first);
+  if(saving) {
+    _outputBuffersStateOffset = outputBuffersStart;
+    _outputBuffersStateSize = GetStreamPosition() - outputBuffersStart;
+  }
 
 	if(!saving) {
 		EmulationSettings::SetFlagState(EmulationFlags::DisablePpu2004Reads, disablePpu2004Reads);
@@ -1211,5 +1287,7 @@ void PPU::StreamState(bool saving)
 
 		UpdateApuStatus();
     SendFrame();
+    //SendFrame switches to the other output buffer, switch back so that saving right after loading gives the same state
+    _currentOutputBuffer = _outputBuffers[is_first ? 0 : 1];
 	}
 }
@@ -6,6 +6,7 @@
 #include "Types.h"
 #include "DebuggerTypes.h"
 #include "IMemoryHandler.h"
+#include "Console.h"
 
 enum class NesModel;
 
@@ -27,8 +28,9 @@ enum PPURegisters
 class PPU : public IMemoryHandler, public Snapshotable
 {
 	protected:
-		static PPU* Instance;
+		static PPU* GetInstance() { return Console::GetCurrent()->GetPpu(); }
 
+		Console *_console;
 		BaseMapper *_mapper;
 
 		PPUState _state;
@@ -100,6 +102,13 @@ class PPU : public IMemoryHandler, public Snapshotable
 
 		int32_t _oamDecayCycles[0x40];
 		bool _enableOamDecay;
+
+		//Logic-only mode: nothing is drawn, the PPU only keeps what the game can observe (sprite 0 hit, etc.)
+		bool _skipRender = false;
+
+		//Where the output buffers were written in the last snapshot saved (see GetOutputBuffersStateRange)
+		uint32_t _outputBuffersStateOffset = 0;
+		uint32_t _outputBuffersStateSize = 0;
 		
 		void UpdateStatusFlag();
 
@@ -136,6 +145,9 @@ class PPU : public IMemoryHandler, public Snapshotable
 
 		__forceinline uint8_t GetPixelColor();
 		__forceinline virtual void DrawPixel();
+		//Called once per background/sprite tile fetch (after both pattern bytes are loaded), used by InstrumentingPpu
+		virtual void ProcessTileFetch(TileInfo &tile) { }
+		virtual void ProcessSpriteTileFetch(SpriteInfo &sprite) { }
 		void UpdateGrayscaleAndIntensifyBits();
 		virtual void SendFrame();
 
@@ -158,7 +170,15 @@ class PPU : public IMemoryHandler, public Snapshotable
 		static const uint32_t PixelCount = 256*240;
 		static const uint32_t OutputBufferSize = 256*240*2;
 
-		PPU(BaseMapper *mapper);
+		//Range taken by the output buffers (and which one is current) in the last snapshot saved, from the start of the PPU's snapshot.
+		//Delta states use it to leave the picture out (see Console::SaveStateDelta)
+		void GetOutputBuffersStateRange(uint32_t &offset, uint32_t &size)
+		{
+			offset = _outputBuffersStateOffset;
+			size = _outputBuffersStateSize;
+		}
+
+		PPU(Console *console, BaseMapper *mapper);
 		virtual ~PPU();
 
 		void Reset();
@@ -183,36 +203,53 @@ class PPU : public IMemoryHandler, public Snapshotable
 		void SetNesModel(NesModel model);
 		
 		void Exec();
-		static void ExecStatic();
+		//One CPU cycle's worth of dots when the PPU runs exactly 3 dots per CPU cycle - shared by ProcessCpuClock and CatchUp
+		__forceinline void RunStandardCpuCycle();
+		//Runs the PPU for one CPU cycle (called by the CPU)
+		void ProcessCpuClock();
+
+		//Runs the PPU for the given number of CPU cycles at once, when the CPU lets it lag behind (see CPU::SyncPpu)
+		void CatchUp(uint32_t cpuCycles);
+		//Returns how many CPU cycles the PPU can lag behind before it could set the NMI flag or start a new frame,
+		//or -1 when it has to run in lockstep with the CPU
+		int32_t GetCatchUpWindow();
+		//Bit 7 of the next $2002 read, once the PPU has caught up (see CPU::SkipIdleLoop)
+		bool IsVerticalBlankFlagSet() { return _statusFlags.VerticalBlank; }
+		//True when $2004 writes go straight to OAM and nothing reads OAM or moves OAMADDR until the PPU has to be synced again
+		//(see CPU::RunDMATransfer): rendering is off or the PPU is in vertical blank, and there is no OAM decay or PAL OAM refresh
+		bool IsSpriteRamIdle() { return !_enableOamDecay && _nesModel != NesModel::PAL && (_scanline >= 240 || !IsRenderingEnabled()); }
+		//Same as writing the page's 256 bytes to $2004, when IsSpriteRamIdle()
+		void WriteSpriteRamPage(uint8_t* source);
 		
-		static void RunOneCycle()
+		static uint32_t GetFrameCount()
 		{
-			Instance->Exec();
+			return GetInstance()->_frameCount;
 		}
 
-		static uint32_t GetFrameCount()
+		//Used by remocon for frames whose output isn't needed: the output buffer (and InstrumentingPpu's data, see InstrumentingPpu::SetTrackTilesWhenSkipping) are not updated
+		static void SetSkipRender(bool skipRender)
 		{
-			return PPU::Instance->_frameCount;
+			GetInstance()->_skipRender = skipRender;
 		}
 
-		static uint32_t GetFrameCycle()
+		uint32_t GetFrameCycle()
 		{
-			return ((PPU::Instance->_scanline + 1) * 341) + PPU::Instance->_cycle;
+			return ((_scanline + 1) * 341) + _cycle;
 		}
 
 		static PPUControlFlags GetControlFlags()
 		{
-			return PPU::Instance->_flags;
+			return GetInstance()->_flags;
 		}
 
 		static uint32_t GetCurrentCycle()
 		{
-			return PPU::Instance->_cycle;
+			return GetInstance()->_cycle;
 		}
 
 		static int32_t GetCurrentScanline()
 		{
-			return PPU::Instance->_scanline;
+			return GetInstance()->_scanline;
 		}
 		
 		uint8_t* GetSpriteRam()
@@ -228,13 +265,13 @@ class PPU : public IMemoryHandler, public Snapshotable
 		static uint32_t GetPixelBrightness(uint8_t x, uint8_t y)
 		{
 			//Used by Zapper, gives a rough approximation of the brightness level of the specific pixel
-			uint16_t pixelData = PPU::Instance->_currentOutputBuffer[y << 8 | x];
+			uint16_t pixelData = GetInstance()->_currentOutputBuffer[y << 8 | x];
 			uint32_t argbColor = EmulationSettings::GetRgbPalette()[pixelData & 0x3F];
 			return (argbColor & 0xFF) + ((argbColor >> 8) & 0xFF) + ((argbColor >> 16) & 0xFF);
 		}
 
 		static uint16_t GetPixel(uint8_t x, uint8_t y)
 		{
-			return PPU::Instance->_currentOutputBuffer[y << 8 | x];
+			return GetInstance()->_currentOutputBuffer[y << 8 | x];
 		}
 };
@@ -28,6 +28,8 @@ protected:
 		Stream(_irqCounter);
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		_irqCounter--;
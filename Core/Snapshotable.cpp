@@ -2,19 +2,25 @@
 #include <algorithm>
 #include "Snapshotable.h"
 
+thread_local vector<uint8_t> Snapshotable::_streamBuffer;
+
 void Snapshotable::StreamStartBlock()
 {
 	if(_inBlock) {
 		throw new std::runtime_error("Cannot start a new block before ending the last block");
 	}
 
-	_blockBuffer = new uint8_t[0xFFFFF];
-	if(!_saving) {
-		InternalStream(_blockSize);
-		ArrayInfo<uint8_t> arrayInfo = { _blockBuffer, std::min((uint32_t)0xFFFFF, _blockSize) };
-		InternalStream(arrayInfo);
+	if(_saving) {
+		//The block's header (its size, written twice like an array of bytes) is filled in by StreamEndBlock
+		_blockStart = _position;
+		_position += sizeof(uint32_t) * 2;
+	} else {
+		uint32_t blockSize = 0;
+		InternalStream(blockSize);
+		uint32_t count = 0;
+		InternalStream(count);
+		_blockEnd = _position + std::min({ blockSize, count, _streamSize - _position });
 	}
-	_blockPosition = 0;
 	_inBlock = true;
 }
 
@@ -22,81 +28,111 @@ void Snapshotable::StreamEndBlock()
 {
 	_inBlock = false;
 	if(_saving) {
-		InternalStream(_blockPosition);
-		ArrayInfo<uint8_t> arrayInfo = { _blockBuffer, _blockPosition };
-		InternalStream(arrayInfo);
+		uint32_t blockSize = _position - _blockStart - sizeof(uint32_t) * 2;
+		if(_position <= _streamSize) {
+			memcpy(_stream + _blockStart, &blockSize, sizeof(uint32_t));
+			memcpy(_stream + _blockStart + sizeof(uint32_t), &blockSize, sizeof(uint32_t));
+		}
+	} else {
+		_position = _blockEnd;
 	}
-
-	delete[] _blockBuffer;
-	_blockBuffer = nullptr;
 }
 
 void Snapshotable::Stream(Snapshotable* snapshotable)
 {
-	stringstream stream;
 	if(_saving) {
-		snapshotable->SaveSnapshot(&stream);
-		uint32_t size = (uint32_t)stream.tellp();
-		stream.seekg(0, ios::beg);
-		stream.seekp(0, ios::beg);
-
-		uint8_t *buffer = new uint8_t[size];
-		stream.read((char*)buffer, size);
-		InternalStream(size);
-		ArrayInfo<uint8_t> arrayInfo = { buffer, size };
-		InternalStream(arrayInfo);
-		delete[] buffer;
+		//Same layout as an array of bytes (size + count + data), the nested snapshot is written in place after the header
+		uint32_t headerPosition = _position;
+		_position += sizeof(uint32_t) * 2;
+
+		uint32_t available = _position < _streamSize ? _streamSize - _position : 0;
+		uint32_t size = snapshotable->SaveSnapshot(available ? _stream + _position : nullptr, available);
+		if(headerPosition + sizeof(uint32_t) * 2 <= _streamSize) {
+			memcpy(_stream + headerPosition, &size, sizeof(uint32_t));
+			memcpy(_stream + headerPosition + sizeof(uint32_t), &size, sizeof(uint32_t));
+		}
+		_position += size;
 	} else {
 		uint32_t size = 0;
 		InternalStream(size);
+		uint32_t count = 0;
+		InternalStream(count);
 
-		uint8_t *buffer = new uint8_t[size];
-		ArrayInfo<uint8_t> arrayInfo = { buffer, size };
-		InternalStream(arrayInfo);
-
-		stream.write((char*)buffer, size);
-		stream.seekg(0, ios::beg);
-		stream.seekp(0, ios::beg);
-		snapshotable->LoadSnapshot(&stream);
-		delete[] buffer;
+		uint32_t length = std::min({ size, count, GetLoadLimit() - _position });
+		snapshotable->LoadSnapshot(_stream + _position, length);
+		_position += length;
 	}
 }
 
-void Snapshotable::SaveSnapshot(ostream* file)
+uint32_t Snapshotable::SaveSnapshot(uint8_t* buffer, uint32_t bufferSize)
 {
-	_stream = new uint8_t[0xFFFFF];
-	_position = 0;
+	_stream = buffer;
+	_streamSize = bufferSize;
+	_position = sizeof(uint32_t);
 	_saving = true;
 
 	StreamState(_saving);
-	file->write((char*)&_position, sizeof(_position));
-	file->write((char*)_stream, _position);
-
-	delete[] _stream;
 
-	if(_blockBuffer) {
+	if(_inBlock) {
 		throw new std::runtime_error("A call to StreamEndBlock is missing.");
 	}
+
+	uint32_t dataSize = _position - sizeof(uint32_t);
+	if(bufferSize >= sizeof(uint32_t)) {
+		memcpy(buffer, &dataSize, sizeof(uint32_t));
+	}
+	_stream = nullptr;
+	return _position;
 }
 
-void Snapshotable::LoadSnapshot(istream* file)
+uint32_t Snapshotable::LoadSnapshot(uint8_t* buffer, uint32_t bufferSize)
 {
-	_stream = new uint8_t[0xFFFFF];
-	memset((char*)_stream, 0, 0xFFFFF);
-	_position = 0;
+	uint32_t dataSize = 0;
+	if(bufferSize >= sizeof(uint32_t)) {
+		memcpy(&dataSize, buffer, sizeof(uint32_t));
+		dataSize = std::min(dataSize, bufferSize - (uint32_t)sizeof(uint32_t));
+	}
+
+	_stream = buffer;
+	_streamSize = sizeof(uint32_t) + dataSize;
+	_position = sizeof(uint32_t);
 	_saving = false;
 
-	file->read((char*)&_streamSize, sizeof(_streamSize));
-	file->read((char*)_stream, _streamSize);
 	StreamState(_saving);
 
 	AfterLoadState();
 
-	delete[] _stream;
-
-	if(_blockBuffer) {
+	if(_inBlock) {
 		throw new std::runtime_error("A call to StreamEndBlock is missing.");
 	}
+
+	_stream = nullptr;
+	return _streamSize;
+}
+
+void Snapshotable::SaveSnapshot(ostream* file)
+{
+	uint32_t size = SaveSnapshot(_streamBuffer.data(), (uint32_t)_streamBuffer.size());
+	if(size > _streamBuffer.size()) {
+		_streamBuffer.resize(size);
+		SaveSnapshot(_streamBuffer.data(), size);
+	}
+	file->write((char*)_streamBuffer.data(), size);
+}
+
+void Snapshotable::LoadSnapshot(istream* file)
+{
+	uint32_t dataSize = 0;
+	file->read((char*)&dataSize, sizeof(dataSize));
+	if(_streamBuffer.size() < sizeof(uint32_t) + dataSize) {
+		_streamBuffer.resize(sizeof(uint32_t) + dataSize);
+	}
+	file->read((char*)_streamBuffer.data() + sizeof(uint32_t), dataSize);
+
+	//If the state is truncated, only load what was actually read (the rest is set to default values)
+	dataSize = (uint32_t)file->gcount();
+	memcpy(_streamBuffer.data(), &dataSize, sizeof(uint32_t));
+	LoadSnapshot(_streamBuffer.data(), sizeof(uint32_t) + dataSize);
 }
 
 void Snapshotable::WriteEmptyBlock(ostream* file)
@@ -110,4 +146,4 @@ void Snapshotable::SkipBlock(istream* file)
 	int blockSize = 0;
 	file->read((char*)&blockSize, sizeof(blockSize));
 	file->seekg(blockSize, ios::cur);
-}
\ No newline at end of file
+}
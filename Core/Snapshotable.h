@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stdafx.h"
+#include <algorithm>
 
 class Snapshotable;
 
@@ -32,48 +33,49 @@ struct EmptyInfo
 class Snapshotable
 {
 private:
-	uint8_t* _stream;
-	uint32_t _position;
-	uint32_t _streamSize;
+	//Snapshots are written to (and read from) the caller's buffer in place, including blocks and nested snapshots.
+	//When saving, _streamSize is the buffer's capacity: nothing is written past it, but _position keeps counting
+	//so the caller can find out how large the buffer needs to be.
+	uint8_t* _stream = nullptr;
+	uint32_t _position = 0;
+	uint32_t _streamSize = 0;
 
 	bool _inBlock = false;
-	uint8_t* _blockBuffer = nullptr;
-	uint32_t _blockSize = 0;
-	uint32_t _blockPosition = 0;
+	uint32_t _blockStart = 0;
+	uint32_t _blockEnd = 0;
 
 	bool _saving;
 
+	//Used by the stream-based SaveSnapshot/LoadSnapshot
+	thread_local static vector<uint8_t> _streamBuffer;
+
 private:
+	uint32_t GetLoadLimit()
+	{
+		return _inBlock ? _blockEnd : _streamSize;
+	}
+
+	void WriteBytes(void* data, uint32_t size)
+	{
+		if(_position + size <= _streamSize) {
+			memcpy(_stream + _position, data, size);
+		}
+		_position += size;
+	}
+
 	template<typename T>
 	void StreamElement(T &value, T defaultValue = T())
 	{
 		if(_saving) {
-			uint8_t* bytes = (uint8_t*)&value;
-			int typeSize = sizeof(T);
-			for(int i = 0; i < typeSize; i++) {
-				if(_inBlock) {
-					_blockBuffer[_blockPosition++] = bytes[i];
-				} else {
-					_stream[_position++] = bytes[i];
-				}
-			}
+			WriteBytes(&value, sizeof(T));
 		} else {
-			if(_inBlock) {
-				if(_blockPosition + sizeof(T) <= _blockSize) {
-					value = *((T*)(_blockBuffer + _blockPosition));
-					_blockPosition += sizeof(T);
-				} else {
-					value = defaultValue;
-					_blockPosition = _blockSize;
-				}
+			uint32_t limit = GetLoadLimit();
+			if(_position + sizeof(T) <= limit) {
+				memcpy(&value, _stream + _position, sizeof(T));
+				_position += sizeof(T);
 			} else {
-				if(_position + sizeof(T) <= _streamSize) {
-					value = *((T*)(_stream + _position));
-					_position += sizeof(T);
-				} else {
-					value = defaultValue;
-					_position = _streamSize;
-				}
+				value = defaultValue;
+				_position = limit;
 			}
 		}
 	}
@@ -81,30 +83,36 @@ private:
 	template<typename T>
 	void InternalStream(EmptyInfo<T> &info)
 	{
-		if(_inBlock) {
-			_blockPosition += sizeof(T);
+		if(_saving) {
+			T empty = T();
+			WriteBytes(&empty, sizeof(T));
 		} else {
-			_position += sizeof(T);
+			_position = std::min<uint32_t>(_position + sizeof(T), GetLoadLimit());
 		}
 	}
 
 	template<typename T>
 	void InternalStream(ArrayInfo<T> &info)
 	{
-		T* pointer = info.Array;
-
 		uint32_t count = info.ElementCount;
 		StreamElement<uint32_t>(count);
 
-		if(!_saving) {
-			//Reset array to 0 before loading from file
-			memset(info.Array, 0, sizeof(T) * info.ElementCount);
-		}
+		//Save/load the number of elements requested, or the maximum possible (based on what is present in the save state)
+		uint32_t elementCount = std::min(info.ElementCount, count);
+		if(_saving) {
+			WriteBytes(info.Array, sizeof(T) * elementCount);
+		} else {
+			uint32_t limit = GetLoadLimit();
+			uint32_t loadedCount = std::min(elementCount, (limit - _position) / (uint32_t)sizeof(T));
+			memcpy(info.Array, _stream + _position, sizeof(T) * loadedCount);
+			_position += sizeof(T) * loadedCount;
+			if(loadedCount < elementCount) {
+				//The state ends before the array does
+				_position = limit;
+			}
 
-		//Load the number of elements requested, or the maximum possible (based on what is present in the save state)
-		for(uint32_t i = 0; i < info.ElementCount && i < count; i++) {
-			StreamElement<T>(*pointer);
-			pointer++;
+			//Reset the rest of the array to 0
+			memset(info.Array + loadedCount, 0, sizeof(T) * (info.ElementCount - loadedCount));
 		}
 	}
 
@@ -145,6 +153,9 @@ protected:
 	virtual void StreamState(bool saving) = 0;
 	virtual void AfterLoadState() { }
 
+	//Position in the snapshot being saved or loaded, from the start of this component's snapshot
+	uint32_t GetStreamPosition() { return _position; }
+
 	void Stream(Snapshotable* snapshotable);
 
 	template<typename... T>
@@ -159,6 +170,13 @@ public:
 	void SaveSnapshot(ostream* file);
 	void LoadSnapshot(istream* file);
 
+	//Writes the snapshot at the start of buffer and returns its size - nothing is written past bufferSize,
+	//so if the returned size is larger than bufferSize, the call must be repeated with a large enough buffer
+	uint32_t SaveSnapshot(uint8_t* buffer, uint32_t bufferSize);
+
+	//Loads a snapshot from the start of buffer and returns the number of bytes it used
+	uint32_t LoadSnapshot(uint8_t* buffer, uint32_t bufferSize);
+
 	static void WriteEmptyBlock(ostream* file);
 	static void SkipBlock(istream* file);
 };
\ No newline at end of file
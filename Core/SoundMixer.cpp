@@ -8,6 +8,7 @@
 #include "RewindManager.h"
 #include "WaveRecorder.h"
 #include "OggMixer.h"
+#include "Console.h"
 
 IAudioDevice* SoundMixer::AudioDevice = nullptr;
 unique_ptr<WaveRecorder> SoundMixer::_waveRecorder;
@@ -110,7 +111,10 @@ void SoundMixer::PlayAudioBuffer(uint32_t time)
 		}
 	}
 
-	if(_oggMixer) {
+	//Only the default console outputs sound (audio device, recorders, rewind)
+	bool isDefaultConsole = Console::GetCurrent()->IsDefaultInstance();
+
+	if(_oggMixer && isDefaultConsole) {
 		_oggMixer->ApplySamples(_outputBuffer, sampleCount);
 	}
 
@@ -138,7 +142,7 @@ void SoundMixer::PlayAudioBuffer(uint32_t time)
 		_crossFeedFilter.ApplyFilter(_outputBuffer, sampleCount, EmulationSettings::GetCrossFeedRatio());
 	}
 
-	if(RewindManager::SendAudio(_outputBuffer, (uint32_t)sampleCount, _sampleRate)) {
+	if(isDefaultConsole && RewindManager::SendAudio(_outputBuffer, (uint32_t)sampleCount, _sampleRate)) {
 		if(_waveRecorder) {
 			auto lock = _waveRecorderLock.AcquireSafe();
 			if(_waveRecorder) {
@@ -155,7 +159,7 @@ void SoundMixer::PlayAudioBuffer(uint32_t time)
 		}
 	}
 
-	if(EmulationSettings::NeedAudioSettingsUpdate()) {
+	if(EmulationSettings::NeedAudioSettingsUpdate(_audioSettingsRevision)) {
 		if(EmulationSettings::GetSampleRate() != _sampleRate) {
 			//Update sample rate for next frame if setting changed
 			_sampleRate = EmulationSettings::GetSampleRate();
@@ -282,10 +286,13 @@ void SoundMixer::EndFrame(uint32_t time)
 		blip_end_frame(_blipBufRight, time);
 	}
 
-	if(muteFrame) {
-		_muteFrameCount++;
-	} else {
-		_muteFrameCount = 0;
+	//The mute frame counter (used by the NSF player) is shared - only the default console updates it
+	if(Console::GetCurrent()->IsDefaultInstance()) {
+		if(muteFrame) {
+			_muteFrameCount++;
+		} else {
+			_muteFrameCount = 0;
+		}
 	}
 
 	//Reset everything
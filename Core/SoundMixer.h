@@ -63,6 +63,7 @@ private:
 	NesModel _model;
 	uint32_t _sampleRate;
 	uint32_t _clockRate;
+	uint32_t _audioSettingsRevision = 0;
 
 	bool _hasPanning;
 
@@ -34,6 +34,9 @@ protected:
 		_irqDelay = _isFlintstones ? 19 : 6;
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+	virtual bool RequiresPpuSync() override { return MMC3::RequiresPpuSync() || _irqDelay > 0; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqDelay > 0) {
@@ -60,6 +60,8 @@ protected:
 		SelectPRGPage(3, -1);
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_irqEnabled) {
@@ -127,6 +127,7 @@ struct TileInfo
 	
 	int32_t AbsoluteTileAddr; //used by HD ppu
 	uint8_t OffsetY; //used by HD ppu
+	uint16_t InstrumentationIndex; //used by InstrumentingPpu
 };
 
 struct SpriteInfo : TileInfo
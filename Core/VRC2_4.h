@@ -95,6 +95,8 @@ class VRC2_4 : public BaseMapper
 			UpdateState();
 		}
 
+		virtual bool EnableCpuClockHook() override { return true; }
+
 		void ProcessCpuClock() override
 		{
 			if((_useHeuristics && _mapperID != 22) || _variant >= VRCVariant::VRC4a) {
@@ -28,6 +28,8 @@ protected:
 		Stream(_irqEnableOnAck, _smallCounter, _irqEnabled, _irqCounter, _irqReload);
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	virtual void ProcessCpuClock() override
 	{
 		if(_irqEnabled) {
@@ -1,4 +1,2 @@
 #include "stdafx.h"
-#include "VsControlManager.h"
-
-VsControlManager *VsControlManager::_instance = nullptr;
\ No newline at end of file
+#include "VsControlManager.h"
\ No newline at end of file
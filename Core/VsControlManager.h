@@ -21,7 +21,6 @@ enum class VsInputType
 class VsControlManager : public ControlManager
 {
 private:
-	static VsControlManager *_instance;
 	uint8_t _prgChrSelectBit;
 	uint8_t _dipSwitches = 0;
 	bool _serviceButton = false;
@@ -63,18 +62,6 @@ private:
 	}
 
 public:
-	VsControlManager()
-	{
-		_instance = this;
-	}
-
-	virtual ~VsControlManager()
-	{
-		if(_instance == this) {
-			_instance = nullptr;
-		}
-	}
-
 	shared_ptr<BaseControlDevice> GetZapper(uint8_t port) override
 	{
 		return shared_ptr<BaseControlDevice>(new VsZapper(port));
@@ -87,7 +74,7 @@ public:
 
 	static VsControlManager* GetInstance()
 	{
-		return _instance;
+		return dynamic_cast<VsControlManager*>(Console::GetCurrent()->GetControlManager());
 	}
 
 	void StreamState(bool saving) override
@@ -135,8 +122,8 @@ public:
 	{
 		ButtonState ports[2];
 		shared_ptr<StandardController> controllers[2];
-		controllers[0] = std::dynamic_pointer_cast<StandardController>(GetControlDevice(0));
-		controllers[1] = std::dynamic_pointer_cast<StandardController>(GetControlDevice(1));
+		controllers[0] = std::dynamic_pointer_cast<StandardController>(_controlDevices[0]);
+		controllers[1] = std::dynamic_pointer_cast<StandardController>(_controlDevices[1]);
 		if(controllers[0]) {
 			ports[0].FromByte(controllers[0]->GetInternalState());
 		}
@@ -34,6 +34,8 @@ protected:
 		Stream(_prgChrSelectBit);
 	}
 
+	virtual bool EnableCpuClockHook() override { return true; }
+
 	void ProcessCpuClock() override
 	{
 		if(_prgChrSelectBit != VsControlManager::GetInstance()->GetPrgChrSelectBit()) {
@@ -1315,6 +1315,12 @@ namespace Mesen.GUI
 
 		IntegerFpsMode = 0x2000000000000,
 
+		FusedCpuCore = 0x4000000000000,
+
+		SkipIdleLoops = 0x8000000000000,
+
+		PrgDecodeCache = 0x10000000000000,
+
 		ForceMaxSpeed = 0x4000000000000000,
 		ConsoleMode = 0x8000000000000000,
 	}
@@ -0,0 +1,88 @@
+#include "stdafx.h"
+#include <assert.h>
+#include "PauseLock.h"
+
+PauseLock::PauseLock()
+{
+	_pauseRequested = false;
+	_workerRunning = false;
+	_pauseCount = 0;
+}
+
+bool PauseLock::IsRunningWorker()
+{
+	return _workerRunning && _workerThreadID == std::this_thread::get_id();
+}
+
+void PauseLock::AcquireRun()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_signal.wait(lock, [this] { return _pauseCount == 0; });
+	_workerRunning = true;
+	_workerThreadID = std::this_thread::get_id();
+}
+
+void PauseLock::ReleaseRun()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_workerRunning = false;
+	_workerThreadID = std::thread::id();
+	_signal.notify_all();
+}
+
+void PauseLock::WaitWhilePaused()
+{
+	ReleaseRun();
+	AcquireRun();
+}
+
+bool PauseLock::WaitForPauseRequest(double timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _signal.wait_for(lock, std::chrono::duration<double, std::milli>(timeoutMs), [this] { return _pauseRequested.load(); });
+}
+
+void PauseLock::Pause()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	if(IsRunningWorker()) {
+		return;
+	}
+	if(_pauseCount > 0 && _pauseThreadID == std::this_thread::get_id()) {
+		_pauseCount++;
+		return;
+	}
+
+	//Wait for any other thread that has the worker paused to resume it
+	_signal.wait(lock, [this] { return _pauseCount == 0; });
+	_pauseCount = 1;
+	_pauseThreadID = std::this_thread::get_id();
+
+	_pauseRequested = true;
+	_signal.notify_all();
+	_signal.wait(lock, [this] { return !_workerRunning; });
+}
+
+void PauseLock::Resume()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	if(IsRunningWorker()) {
+		return;
+	}
+	if(_pauseCount > 0 && _pauseThreadID == std::this_thread::get_id()) {
+		_pauseCount--;
+		if(_pauseCount == 0) {
+			_pauseThreadID = std::thread::id();
+			_pauseRequested = false;
+			_signal.notify_all();
+		}
+	} else {
+		assert(false);
+	}
+}
+
+bool PauseLock::IsHeld()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _workerRunning || _pauseCount > 0;
+}
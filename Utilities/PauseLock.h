@@ -0,0 +1,50 @@
+#pragma once
+#include "stdafx.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//Lets other threads pause a worker thread (the emulation loop) and wait until it has stopped, without spinning on either
+//side.  The worker holds the lock while it runs (AcquireRun/ReleaseRun) and checks IsPauseRequested wherever it can stop
+//(it is a single relaxed atomic load); Pause blocks until the worker has released the lock, or returns right away if no
+//worker holds it.
+//Pause is reentrant for the thread that holds it, and a no-op when called by the worker itself while it runs (it can't be
+//running anything another thread would be in the middle of).  Only one thread at a time can have the worker paused.
+class PauseLock
+{
+private:
+	std::mutex _mutex;
+	std::condition_variable _signal;
+
+	//Set from the time a thread starts waiting for the worker to stop until it resumes it
+	atomic<bool> _pauseRequested;
+
+	bool _workerRunning;
+	std::thread::id _workerThreadID;
+
+	uint32_t _pauseCount;
+	std::thread::id _pauseThreadID;
+
+	bool IsRunningWorker();
+
+public:
+	PauseLock();
+
+	//Called by the worker: waits until no thread has it paused, then holds the lock
+	void AcquireRun();
+	//Called by the worker: lets pending and later Pause calls return until the next AcquireRun
+	void ReleaseRun();
+
+	bool IsPauseRequested() { return _pauseRequested.load(std::memory_order_relaxed); }
+	//Called by the worker when IsPauseRequested returned true: stops until the thread that paused it resumes it
+	void WaitWhilePaused();
+	//Called by the worker instead of sleeping: returns after timeoutMs, or as soon as a thread asks to pause it (true)
+	bool WaitForPauseRequest(double timeoutMs);
+
+	void Pause();
+	void Resume();
+
+	//True while the worker runs or a thread has it paused
+	bool IsHeld();
+};
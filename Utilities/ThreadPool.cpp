@@ -0,0 +1,164 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if(threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	_participantCount = threadCount;
+	_ranges.reset(new WorkRange[_participantCount]);
+	for(uint32_t i = 0; i < _participantCount; i++) {
+		_ranges[i].Range = 0;
+	}
+
+	//Participant 0 is the thread calling ParallelFor
+	for(uint32_t i = 1; i < _participantCount; i++) {
+		_threads.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_stop = true;
+		_startSignal.notify_all();
+	}
+	for(std::thread &thread : _threads) {
+		thread.join();
+	}
+}
+
+uint32_t ThreadPool::GetThreadCount()
+{
+	return _participantCount;
+}
+
+bool ThreadPool::PopIndex(uint32_t participant, uint32_t &index)
+{
+	atomic<uint64_t> &range = _ranges[participant].Range;
+	uint64_t value = range.load();
+	while(true) {
+		uint32_t begin = (uint32_t)value;
+		uint32_t end = (uint32_t)(value >> 32);
+		if(begin >= end) {
+			return false;
+		}
+		if(range.compare_exchange_weak(value, PackRange(begin + 1, end))) {
+			index = begin;
+			return true;
+		}
+	}
+}
+
+bool ThreadPool::StealIndex(uint32_t participant, uint32_t &index)
+{
+	for(uint32_t i = 1; i < _participantCount; i++) {
+		atomic<uint64_t> &victim = _ranges[(participant + i) % _participantCount].Range;
+		uint64_t value = victim.load();
+		while(true) {
+			uint32_t begin = (uint32_t)value;
+			uint32_t end = (uint32_t)(value >> 32);
+			if(begin >= end) {
+				break;
+			}
+
+			//Take the upper half of the victim's remaining items (at least one)
+			uint32_t split = begin + (end - begin) / 2;
+			if(victim.compare_exchange_weak(value, PackRange(begin, split))) {
+				//Our own range is empty at this point, nobody else can be updating it
+				_ranges[participant].Range = PackRange(split + 1, end);
+				index = split;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void ThreadPool::RunTasks(uint32_t participant)
+{
+	uint32_t index;
+	while(PopIndex(participant, index) || StealIndex(participant, index)) {
+		try {
+			_func(index);
+		} catch(...) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			if(!_exception) {
+				_exception = std::current_exception();
+			}
+		}
+	}
+}
+
+void ThreadPool::WorkerLoop(uint32_t participant)
+{
+	uint64_t generation = 0;
+	while(true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_startSignal.wait(lock, [&] { return _stop || _generation != generation; });
+			if(_stop) {
+				return;
+			}
+			generation = _generation;
+		}
+
+		RunTasks(participant);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		if(--_busyWorkers == 0) {
+			_doneSignal.notify_all();
+		}
+	}
+}
+
+void ThreadPool::ParallelFor(uint32_t count, std::function<void(uint32_t)> func)
+{
+	if(count == 0) {
+		return;
+	}
+
+	if(_participantCount == 1 || count == 1) {
+		for(uint32_t i = 0; i < count; i++) {
+			func(i);
+		}
+		return;
+	}
+
+	_func = func;
+	_exception = nullptr;
+
+	//Split the range evenly, the first (count % participants) ranges get one extra item
+	uint32_t begin = 0;
+	for(uint32_t i = 0; i < _participantCount; i++) {
+		uint32_t size = count / _participantCount + (i < count % _participantCount ? 1 : 0);
+		_ranges[i].Range = PackRange(begin, begin + size);
+		begin += size;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_busyWorkers = (uint32_t)_threads.size();
+		_generation++;
+		_startSignal.notify_all();
+	}
+
+	RunTasks(0);
+
+	//Every participant only returns from RunTasks once there is nothing left to pop or steal,
+	//so all items are done once all workers are idle again
+	std::unique_lock<std::mutex> lock(_mutex);
+	_doneSignal.wait(lock, [this] { return _busyWorkers == 0; });
+	_func = nullptr;
+
+	if(_exception) {
+		std::exception_ptr exception = _exception;
+		_exception = nullptr;
+		lock.unlock();
+		std::rethrow_exception(exception);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "stdafx.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+//Fixed-size pool of worker threads used to run data-parallel loops.
+//Every call to ParallelFor splits the index range evenly between the participants (the workers + the calling thread),
+//each participant consumes its own range from the front and steals half of another participant's remaining range
+//from the back once its own range is exhausted, which keeps all cores busy when items have uneven costs.
+class ThreadPool
+{
+private:
+	struct WorkRange
+	{
+		//Begin index in the low 32 bits, end index in the high 32 bits - updated as a whole with CAS
+		alignas(64) atomic<uint64_t> Range;
+	};
+
+	vector<std::thread> _threads;
+	std::unique_ptr<WorkRange[]> _ranges;
+	uint32_t _participantCount;
+
+	std::mutex _mutex;
+	std::condition_variable _startSignal;
+	std::condition_variable _doneSignal;
+	uint64_t _generation = 0;
+	uint32_t _busyWorkers = 0;
+	bool _stop = false;
+
+	std::function<void(uint32_t)> _func;
+	std::exception_ptr _exception;
+
+	static uint64_t PackRange(uint32_t begin, uint32_t end) { return (uint64_t)begin | ((uint64_t)end << 32); }
+
+	bool PopIndex(uint32_t participant, uint32_t &index);
+	bool StealIndex(uint32_t participant, uint32_t &index);
+	void RunTasks(uint32_t participant);
+	void WorkerLoop(uint32_t participant);
+
+public:
+	//threadCount = 0 uses one participant per hardware thread
+	ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	//Total number of threads that execute work, including the thread that calls ParallelFor
+	uint32_t GetThreadCount();
+
+	//Calls func(i) for every i in [0, count) and returns once all calls are done.
+	//Not reentrant: func must not call ParallelFor on the same pool. The first exception thrown by func is rethrown here.
+	void ParallelFor(uint32_t count, std::function<void(uint32_t)> func);
+};
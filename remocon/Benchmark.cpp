@@ -0,0 +1,407 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <Core/Console.h>
+#include <Core/InstrumentingPPU.h>
+#include <Core/BaseMapper.h>
+#include <Core/CPU.h>
+#include <Core/EmulationSettings.h>
+#include <Utilities/Timer.h>
+
+#ifdef __linux__
+# include <time.h>
+#endif
+
+static void PrintRate(const std::string &label, uint32_t count, double elapsedMs) {
+  std::cout << label << ": " << (uint64_t)(count * 1000.0 / elapsedMs) << "/s (" << (elapsedMs * 1000.0 / count) << " us each)\n";
+}
+
+// Saves/loads per second with the in-place snapshot API, with the stream-based API for comparison, and with delta states
+static void BenchmarkSaveStates(uint32_t iterations) {
+  // Get away from the power-on state first
+  for(int i = 0; i < 120; i++) {
+    RunOneFrame(0, 0);
+  }
+
+  std::vector<uint8_t> state(Console::SaveStateTo(nullptr, 0));
+  Console::SaveStateTo(state.data(), state.size());
+  std::cout << "State size: " << state.size() << " bytes\n";
+
+  Timer timer;
+  for(uint32_t i = 0; i < iterations; i++) {
+    Console::SaveStateTo(state.data(), state.size());
+  }
+  PrintRate("SaveStateTo", iterations, timer.GetElapsedMS());
+
+  timer.Reset();
+  for(uint32_t i = 0; i < iterations; i++) {
+    Console::LoadStateFrom(state.data(), state.size());
+  }
+  PrintRate("LoadStateFrom", iterations, timer.GetElapsedMS());
+
+  std::vector<uint8_t> copy(state.size());
+  Console::SaveStateTo(copy.data(), copy.size());
+  std::cout << "Round trip: " << (memcmp(copy.data(), state.data(), state.size()) == 0 ? "OK" : "MISMATCH") << "\n";
+
+  timer.Reset();
+  for(uint32_t i = 0; i < iterations; i++) {
+    std::stringstream stream;
+    Console::SaveState(stream);
+  }
+  PrintRate("SaveState (stream)", iterations, timer.GetElapsedMS());
+
+  timer.Reset();
+  for(uint32_t i = 0; i < iterations; i++) {
+    std::stringstream stream;
+    stream.write((char*)state.data(), state.size());
+    Console::LoadState(stream);
+  }
+  PrintRate("LoadState (stream)", iterations, timer.GetElapsedMS());
+
+  // Delta against the state of the previous frame, like a child node in a search tree
+  RunOneFrame(0, 0);
+  std::vector<uint8_t> frameState(Console::SaveStateTo(nullptr, 0));
+  Console::SaveStateTo(frameState.data(), frameState.size());
+  std::vector<uint8_t> delta(Console::SaveStateDelta(state.data(), state.size(), nullptr, 0));
+  Console::SaveStateDelta(state.data(), state.size(), delta.data(), delta.size());
+  std::cout << "Delta size after 1 frame: " << delta.size() << " bytes (full state: " << frameState.size() << " bytes)\n";
+
+  timer.Reset();
+  for(uint32_t i = 0; i < iterations; i++) {
+    Console::SaveStateDelta(state.data(), state.size(), delta.data(), delta.size());
+  }
+  PrintRate("SaveStateDelta", iterations, timer.GetElapsedMS());
+
+  timer.Reset();
+  for(uint32_t i = 0; i < iterations; i++) {
+    Console::LoadStateDelta(state.data(), state.size(), delta.data(), delta.size());
+  }
+  PrintRate("LoadStateDelta", iterations, timer.GetElapsedMS());
+
+  // The state rebuilt from the delta must be the state after the frame, except for the picture which comes from the parent
+  Console::LoadStateDelta(state.data(), state.size(), delta.data(), delta.size());
+  std::vector<uint8_t> rebuilt(frameState.size());
+  bool deltaMatch = Console::SaveStateTo(rebuilt.data(), rebuilt.size()) == rebuilt.size();
+  uint32_t outputOffset = 0, outputSize = 0;
+  if(deltaMatch) {
+    uint32_t cpuStateSize;
+    memcpy(&cpuStateSize, rebuilt.data(), sizeof(uint32_t));
+    Console::GetCurrent()->GetPpu()->GetOutputBuffersStateRange(outputOffset, outputSize);
+    outputOffset += sizeof(uint32_t) + cpuStateSize;
+    deltaMatch = memcmp(rebuilt.data(), frameState.data(), outputOffset) == 0 &&
+      memcmp(rebuilt.data() + outputOffset, state.data() + outputOffset, outputSize) == 0 &&
+      memcmp(rebuilt.data() + outputOffset + outputSize, frameState.data() + outputOffset + outputSize, rebuilt.size() - outputOffset - outputSize) == 0;
+  }
+  std::cout << "Delta round trip: " << (deltaMatch ? "OK" : "MISMATCH") << " (" << outputSize << " bytes of output buffers taken from the parent)\n";
+}
+
+// Runs frames on a new console (not the default one, which also feeds the audio/video outputs)
+static double RunFrames(const std::string &romPath, bool instrumented, bool skipRender, uint32_t frames, bool forceMapperHooks = false, bool trackTiles = false) {
+  std::shared_ptr<Console> console = std::make_shared<Console>();
+  ConsoleBinding binding(console.get());
+  Console::Pause();
+  if(!Console::LoadROM(romPath)) {
+    std::cerr << "Could not load " << romPath << "\n";
+    return 0;
+  }
+  if(instrumented) {
+    Console::Instrument()->SetTrackTilesWhenSkipping(trackTiles);
+  }
+  console->SetForceMapperHooks(forceMapperHooks);
+  Console::Resume();
+  PPU::SetSkipRender(skipRender);
+
+  Timer timer;
+  for(uint32_t i = 0; i < frames; i++) {
+    RunOneFrame(0, 0);
+  }
+  return timer.GetElapsedMS();
+}
+
+// Frames per second with the plain PPU and with InstrumentingPpu (with no output requested), on the benchmark's ROM,
+// and with InstrumentingPpu in logic-only mode (what Step does for frames without any output), without and with its tile
+// bookkeeping
+static void BenchmarkPpu(uint32_t frames) {
+  std::string romPath = Console::GetRomPath();
+  double plainMs = RunFrames(romPath, false, false, frames);
+  double instrumentedMs = RunFrames(romPath, true, false, frames);
+  double logicOnlyMs = RunFrames(romPath, true, true, frames);
+  double trackedMs = RunFrames(romPath, true, true, frames, false, true);
+  PrintRate("PPU frames", frames, plainMs);
+  PrintRate("InstrumentingPpu frames", frames, instrumentedMs);
+  PrintRate("Logic-only frames", frames, logicOnlyMs);
+  PrintRate("Logic-only frames (tracking tiles)", frames, trackedMs);
+  std::cout << "Instrumentation overhead: " << (instrumentedMs / plainMs) << "x\n";
+  std::cout << "Logic-only speedup: " << (instrumentedMs / logicOnlyMs) << "x\n";
+}
+
+// Logic-only frames per second with the mapper's CPU clock/VRAM address hooks only called if it enables them, and with
+// them called on every CPU cycle/VRAM access regardless (what every mapper used to do)
+static void BenchmarkMapperHooks(uint32_t frames) {
+  std::string romPath = Console::GetRomPath();
+  BaseMapper *mapper = Console::GetCurrent()->GetMapper();
+  std::cout << "Mapper " << mapper->GetMapperId() << ", CPU clock hook: " << (mapper->HasCpuClockHook() ? "yes" : "no")
+    << ", VRAM address hook: " << (mapper->HasVramAddressHook() ? "yes" : "no") << "\n";
+
+  double skippedMs = RunFrames(romPath, false, true, frames);
+  double forcedMs = RunFrames(romPath, false, true, frames, true);
+  PrintRate("Frames (hooks as enabled)", frames, skippedMs);
+  PrintRate("Frames (hooks always called)", frames, forcedMs);
+  std::cout << "Speedup: " << (forcedMs / skippedMs) << "x\n";
+}
+
+// NROM image whose program loops over arithmetic and RAM reads/writes with rendering off, so the CPU core is most of the work
+static std::string MakeCpuLoopRom() {
+  static const uint8_t program[] = {
+    0x78,             // sei
+    0xD8,             // cld
+    0xA2, 0xFF,       // ldx #$FF
+    0x9A,             // txs
+    0xA9, 0x00,       // lda #0
+    0x8D, 0x00, 0x20, // sta $2000
+    0x8D, 0x01, 0x20, // sta $2001
+    0x18,             // loop: clc
+    0x69, 0x07,       // adc #7
+    0x85, 0x00,       // sta $00
+    0x45, 0x01,       // eor $01
+    0x85, 0x01,       // sta $01
+    0xA6, 0x00,       // ldx $00
+    0xE8,             // inx
+    0xBD, 0x00, 0x02, // lda $0200,x
+    0x6A,             // ror a
+    0x9D, 0x00, 0x03, // sta $0300,x
+    0xC8,             // iny
+    0xD0, 0xEA,       // bne loop
+    0x4C, 0x0B, 0x80  // jmp loop
+  };
+  std::string rom(16 + 0x8000 + 0x2000, '\0');
+  memcpy(&rom[0], "NES\x1A\x02\x01", 6);
+  memcpy(&rom[16], program, sizeof(program));
+  // NMI, reset and IRQ vectors all point to $8000
+  for(int i = 0; i < 3; i++) {
+    rom[16 + 0x7FFA + i * 2] = 0x00;
+    rom[16 + 0x7FFB + i * 2] = (char)0x80;
+  }
+  return rom;
+}
+
+// Runs instructions on a new console with the given CPU core flags (FusedCpuCore, PrgDecodeCache) set and the others
+// cleared, returns the elapsed time and the state the console ends up in
+static double RunInstructions(VirtualFile rom, uint64_t cpuFlags, uint32_t count, std::vector<uint8_t> &state) {
+  static const uint64_t CpuCoreFlags = EmulationFlags::FusedCpuCore | EmulationFlags::PrgDecodeCache;
+  std::shared_ptr<Console> console = std::make_shared<Console>();
+  ConsoleBinding binding(console.get());
+  Console::Pause();
+  if(!Console::LoadROM(rom)) {
+    std::cerr << "Could not load " << (std::string)rom << "\n";
+    return 0;
+  }
+  Console::Resume();
+  EmulationSettings::ClearFlags(CpuCoreFlags);
+  EmulationSettings::SetFlags(cpuFlags);
+
+  Timer timer;
+  for(uint32_t i = 0; i < count; i++) {
+    Console::RunOneStep();
+  }
+  double elapsedMs = timer.GetElapsedMS();
+  EmulationSettings::ClearFlags(CpuCoreFlags);
+
+  state.resize(Console::SaveStateTo(nullptr, 0));
+  Console::SaveStateTo(state.data(), state.size());
+  return elapsedMs;
+}
+
+// Compares two states block by block, except the ControlManager's: the controllers' buffers come from the input shared by
+// every console in the process, not from the emulation
+static bool SameEmulationState(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) {
+  static const int ControlManagerBlock = 4;
+  if(a.size() != b.size()) {
+    return false;
+  }
+  size_t position = 0;
+  for(int i = 0; position + sizeof(uint32_t) <= a.size(); i++) {
+    uint32_t size;
+    memcpy(&size, &a[position], sizeof(uint32_t));
+    size_t end = std::min(position + sizeof(uint32_t) + size, a.size());
+    if(i != ControlManagerBlock && memcmp(&a[position], &b[position], end - position) != 0) {
+      return false;
+    }
+    position = end;
+  }
+  return true;
+}
+
+// Instructions per second with both CPU cores, with and without the PRG decode cache, on a CPU-bound loop and on the
+// benchmark's ROM.  All of them must end up in the same state
+static void BenchmarkCpu(uint32_t instructions) {
+  struct CpuCore {
+    std::string Name;
+    uint64_t Flags;
+  };
+  static const CpuCore cores[] = {
+    { "table core", 0 },
+    { "fused core", EmulationFlags::FusedCpuCore },
+    { "table core + decode cache", EmulationFlags::PrgDecodeCache },
+    { "fused core + decode cache", EmulationFlags::FusedCpuCore | EmulationFlags::PrgDecodeCache }
+  };
+
+  std::string loopRom = MakeCpuLoopRom();
+  std::stringstream loopStream(loopRom);
+  std::pair<std::string, VirtualFile> roms[2] = {
+    { "CPU loop", VirtualFile(loopStream, "cpuloop.nes") },
+    { "ROM", Console::GetRomPath() }
+  };
+  for(auto &rom : roms) {
+    std::vector<uint8_t> tableState, state;
+    double tableMs = RunInstructions(rom.second, cores[0].Flags, instructions, tableState);
+    PrintRate(rom.first + ", " + cores[0].Name + " instructions", instructions, tableMs);
+    for(size_t i = 1; i < sizeof(cores) / sizeof(cores[0]); i++) {
+      double elapsedMs = RunInstructions(rom.second, cores[i].Flags, instructions, state);
+      PrintRate(rom.first + ", " + cores[i].Name + " instructions", instructions, elapsedMs);
+      std::cout << rom.first + ", " + cores[i].Name + " speedup: " << (tableMs / elapsedMs) << "x, states " << (SameEmulationState(tableState, state) ? "match" : "MISMATCH") << "\n";
+    }
+  }
+}
+
+// Runs logic-only frames on a new console with or without skipping idle loops, returns the elapsed time, the state the
+// console ends up in, and how many CPU cycles it ran and skipped
+static double RunIdleLoopFrames(const std::string &romPath, bool skipIdleLoops, uint32_t frames, std::vector<uint8_t> &state, uint32_t &cycles, uint64_t &skippedCycles) {
+  std::shared_ptr<Console> console = std::make_shared<Console>();
+  ConsoleBinding binding(console.get());
+  Console::Pause();
+  if(!Console::LoadROM(romPath)) {
+    std::cerr << "Could not load " << romPath << "\n";
+    return 0;
+  }
+  Console::Resume();
+  PPU::SetSkipRender(true);
+  if(skipIdleLoops) {
+    EmulationSettings::SetFlags(EmulationFlags::SkipIdleLoops);
+  } else {
+    EmulationSettings::ClearFlags(EmulationFlags::SkipIdleLoops);
+  }
+
+  int32_t startCycle = CPU::GetCycleCount();
+  Timer timer;
+  for(uint32_t i = 0; i < frames; i++) {
+    RunOneFrame(0, 0);
+  }
+  double elapsedMs = timer.GetElapsedMS();
+  cycles = (uint32_t)(CPU::GetCycleCount() - startCycle);
+  skippedCycles = CPU::GetSkippedIdleCycles();
+  EmulationSettings::ClearFlags(EmulationFlags::SkipIdleLoops);
+
+  state.resize(Console::SaveStateTo(nullptr, 0));
+  Console::SaveStateTo(state.data(), state.size());
+  return elapsedMs;
+}
+
+// Logic-only frames per second with and without skipping idle loops, how much of the game's time is spent in loops that
+// can be skipped, and whether it ends up in the same state either way
+static void BenchmarkIdleLoops(uint32_t frames) {
+  std::string romPath = Console::GetRomPath();
+  std::vector<uint8_t> plainState, skippingState;
+  uint32_t cycles;
+  uint64_t skippedCycles;
+  double plainMs = RunIdleLoopFrames(romPath, false, frames, plainState, cycles, skippedCycles);
+  double skippingMs = RunIdleLoopFrames(romPath, true, frames, skippingState, cycles, skippedCycles);
+  PrintRate("Frames", frames, plainMs);
+  PrintRate("Frames (skipping idle loops)", frames, skippingMs);
+  std::cout << "CPU cycles skipped: " << (100.0 * skippedCycles / cycles) << "%, time saved: " << (100.0 * (1 - skippingMs / plainMs))
+    << "%, states " << (SameEmulationState(plainState, skippingState) ? "match" : "MISMATCH") << "\n";
+}
+
+// CPU time used by the calling thread so far, 0 where it can't be measured
+static double GetThreadCpuMs() {
+#ifdef __linux__
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+#else
+  return 0;
+#endif
+}
+
+// Latency of Console::Pause (until the emulation thread has stopped) with a console running its emulation loop on another
+// thread, at maximum speed (it stops mid-frame) and at normal speed (it mostly sleeps between frames), and the CPU time the
+// pausing thread spends waiting
+static void BenchmarkPause(uint32_t iterations) {
+  std::string romPath = Console::GetRomPath();
+  std::shared_ptr<Console> console = std::make_shared<Console>();
+  ConsoleBinding binding(console.get());
+  if(!Console::LoadROM(romPath)) {
+    std::cerr << "Could not load " << romPath << "\n";
+    return;
+  }
+  // Don't save the game to the recent games list when the loop stops
+  bool disableGameSelection = EmulationSettings::CheckFlag(EmulationFlags::DisableGameSelectionScreen);
+  bool forceMaxSpeed = EmulationSettings::CheckFlag(EmulationFlags::ForceMaxSpeed);
+  EmulationSettings::SetFlags(EmulationFlags::DisableGameSelectionScreen);
+  std::thread emulationThread([&] { console->Run(); });
+
+  for(bool maxSpeed : { true, false }) {
+    if(maxSpeed) {
+      EmulationSettings::SetFlags(EmulationFlags::ForceMaxSpeed);
+    } else {
+      EmulationSettings::ClearFlags(EmulationFlags::ForceMaxSpeed);
+    }
+    std::vector<double> latencies;
+    double waitCpuMs = 0;
+    for(uint32_t i = 0; i < iterations; i++) {
+      // Let it run for a while, at a different point of the frame each time
+      std::this_thread::sleep_for(std::chrono::microseconds(1000 + (i * 7919) % 5000));
+      double startCpuMs = GetThreadCpuMs();
+      Timer timer;
+      Console::Pause();
+      latencies.push_back(timer.GetElapsedMS() * 1000.0);
+      waitCpuMs += GetThreadCpuMs() - startCpuMs;
+      Console::Resume();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for(double latency : latencies) {
+      total += latency;
+    }
+    std::cout << (maxSpeed ? "Maximum speed" : "Normal speed") << ", pause latency: mean " << (total / iterations) << " us, median "
+      << latencies[iterations / 2] << " us, 99th percentile " << latencies[iterations * 99 / 100] << " us, max " << latencies.back()
+      << " us, CPU time while waiting " << (waitCpuMs * 1000.0 / iterations) << " us\n";
+  }
+
+  console->Stop();
+  emulationThread.join();
+  if(!disableGameSelection) {
+    EmulationSettings::ClearFlags(EmulationFlags::DisableGameSelectionScreen);
+  }
+  if(forceMaxSpeed) {
+    EmulationSettings::SetFlags(EmulationFlags::ForceMaxSpeed);
+  } else {
+    EmulationSettings::ClearFlags(EmulationFlags::ForceMaxSpeed);
+  }
+}
+
+bool RunBenchmark(const std::string &name, uint32_t iterations) {
+  if(name == "savestate") {
+    BenchmarkSaveStates(iterations);
+  } else if(name == "ppu") {
+    BenchmarkPpu(iterations);
+  } else if(name == "mapper") {
+    BenchmarkMapperHooks(iterations);
+  } else if(name == "cpu") {
+    BenchmarkCpu(iterations);
+  } else if(name == "idle") {
+    BenchmarkIdleLoops(iterations);
+  } else if(name == "pause") {
+    BenchmarkPause(iterations);
+  } else {
+    std::cerr << "Unknown benchmark: " << name << "\n";
+    return false;
+  }
+  std::cout.flush();
+  return true;
+}
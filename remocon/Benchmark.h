@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Defined in remocon.cpp
+void RunOneFrame(uint8_t p1, uint8_t p2);
+
+// remocon ROM --benchmark NAME [ITERATIONS]
+//   savestate: in-place, stream-based and delta savestates (ITERATIONS saves/loads of each kind)
+//   ppu: frames/sec of the plain PPU vs InstrumentingPpu vs logic-only, with and without tile tracking (ITERATIONS frames
+//        each), run it once per test ROM
+//   mapper: logic-only frames/sec with and without skipping the mapper hooks it doesn't enable, run it once per mapper
+//   cpu: instructions/sec of the table-driven vs the fused CPU core, each with and without the PRG decode cache
+//        (ITERATIONS instructions each), on a built-in CPU-bound loop and on the ROM
+//   idle: logic-only frames/sec with and without skipping idle loops (ITERATIONS frames each), with the share of CPU cycles
+//         skipped, run it once per game
+//   pause: latency of Console::Pause with the ROM running on its own emulation thread, at maximum and normal speed
+//          (ITERATIONS pauses each), and the CPU time spent waiting for it
+// Runs one of the microbenchmarks on the console bound to the calling thread and prints the results to stdout.
+// Returns false if there is no benchmark with that name.
+bool RunBenchmark(const std::string &name, uint32_t iterations);
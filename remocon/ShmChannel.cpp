@@ -0,0 +1,199 @@
+#include "ShmChannel.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#ifdef __linux__
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/syscall.h>
+# include <linux/futex.h>
+# include <time.h>
+# include <unistd.h>
+#endif
+
+static_assert(offsetof(ShmHeader, CommandSeq) == 64, "ShmHeader layout is shared with the python client");
+static_assert(offsetof(ShmHeader, ReadPos) == 128, "ShmHeader layout is shared with the python client");
+static_assert(offsetof(ShmHeader, WritePos) == 192, "ShmHeader layout is shared with the python client");
+static_assert(sizeof(ShmHeader) <= 4096, "ShmHeader must fit in the first page");
+
+// Timeout used for every wait, so we notice when the client closes the channel
+static const int WaitTimeoutMs = 100;
+
+#ifdef __linux__
+static void FutexWait(std::atomic<uint32_t> &word, uint32_t expected) {
+  struct timespec timeout = { 0, WaitTimeoutMs * 1000000 };
+  // Not FUTEX_PRIVATE_FLAG: the word lives in memory shared with another process
+  syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+static void FutexWake(std::atomic<uint32_t> &word) {
+  syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+#endif
+
+ShmChannel::~ShmChannel() {
+#ifdef __linux__
+  if(_segment) {
+    munmap(_segment, _segmentSize);
+    // The client normally unlinks the segment as soon as it has mapped it
+    shm_unlink(_name.c_str());
+  }
+#endif
+}
+
+bool ShmChannel::Open(const std::string &name, uint64_t ringSize, uint64_t commandSize) {
+#ifdef __linux__
+  _name = name;
+  uint64_t commandOffset = 4096;
+  uint64_t ringOffset = commandOffset + ((commandSize + 4095) & ~4095ull);
+  _segmentSize = ringOffset + ringSize;
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+  if(fd < 0) {
+    std::cerr << "Could not create shared memory segment " << name << "\n";
+    return false;
+  }
+  if(ftruncate(fd, _segmentSize) != 0) {
+    std::cerr << "Could not resize shared memory segment " << name << "\n";
+    close(fd);
+    return false;
+  }
+  void *segment = mmap(nullptr, _segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(segment == MAP_FAILED) {
+    std::cerr << "Could not map shared memory segment " << name << "\n";
+    return false;
+  }
+
+  _segment = (uint8_t*)segment;
+  _header = new (_segment) ShmHeader();
+  _header->CommandOffset = commandOffset;
+  _header->CommandSize = commandSize;
+  _header->RingOffset = ringOffset;
+  _header->RingSize = ringSize;
+  _header->Version = Version;
+  _commands = _segment + commandOffset;
+  _ring = _segment + ringOffset;
+  _ringSize = ringSize;
+  // Written last, the client checks it to know the header is complete
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  _header->Magic = Magic;
+  return true;
+#else
+  std::cerr << "Shared memory transport is only supported on Linux\n";
+  return false;
+#endif
+}
+
+bool ShmChannel::WaitForCommand() {
+#ifdef __linux__
+  while(true) {
+    uint32_t seq = _header->CommandSeq.load();
+    if(seq != _commandSeq) {
+      _commandSeq = seq;
+      _commandLength = std::min<uint64_t>(_header->CommandLength.load(), _header->CommandSize);
+      _commandPos = 0;
+      return true;
+    }
+    if(_header->Closed.load()) {
+      _closed = true;
+      return false;
+    }
+    FutexWait(_header->CommandSeq, seq);
+  }
+#else
+  return false;
+#endif
+}
+
+size_t ShmChannel::Read(void *buf, size_t size, size_t count) {
+  if(size == 0 || count == 0) {
+    return 0;
+  }
+  if(_commandPos >= _commandLength && !WaitForCommand()) {
+    return 0;
+  }
+  size_t items = std::min<size_t>(count, (_commandLength - _commandPos) / size);
+  memcpy(buf, _commands + _commandPos, items * size);
+  _commandPos += items * size;
+  return items;
+}
+
+void ShmChannel::Publish() {
+#ifdef __linux__
+  _header->WritePos.store(_writePos);
+  _header->ServerSeq.fetch_add(1);
+  if(_header->ClientWaiting.load()) {
+    FutexWake(_header->ServerSeq);
+  }
+#endif
+}
+
+void ShmChannel::WaitForSpace() {
+#ifdef __linux__
+  // Flag first, then publish: a client that sees the new ServerSeq also sees the flag and releases what it has read
+  _header->WriterWaiting.store(1);
+  Publish();
+  while(true) {
+    uint32_t seq = _header->ClientSeq.load();
+    _readPos = _header->ReadPos.load();
+    if(_writePos - _readPos < _ringSize) {
+      break;
+    }
+    if(_header->Closed.load()) {
+      _closed = true;
+      break;
+    }
+    FutexWait(_header->ClientSeq, seq);
+  }
+  _header->WriterWaiting.store(0);
+#endif
+}
+
+std::streamsize ShmChannel::xsputn(const char *data, std::streamsize count) {
+  std::streamsize written = 0;
+  while(written < count && !_closed) {
+    uint64_t freeSpace = _ringSize - (_writePos - _readPos);
+    if(freeSpace == 0) {
+      _readPos = _header->ReadPos.load();
+      if(_writePos - _readPos == _ringSize) {
+        WaitForSpace();
+      }
+      continue;
+    }
+    uint64_t offset = _writePos % _ringSize;
+    uint64_t chunk = std::min<uint64_t>({ (uint64_t)(count - written), freeSpace, _ringSize - offset });
+    memcpy(_ring + offset, data + written, chunk);
+    _writePos += chunk;
+    written += chunk;
+  }
+  // Once the client is gone, output is dropped
+  return count;
+}
+
+int ShmChannel::overflow(int c) {
+  if(c != traits_type::eof()) {
+    char ch = (char)c;
+    xsputn(&ch, 1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int ShmChannel::sync() {
+  if(_header) {
+    Publish();
+  }
+  return 0;
+}
+
+void ShmChannel::SendReady() {
+  // Whatever the command handler didn't read (e.g. a client sending more than the command needs) is dropped,
+  // otherwise it would be taken as the start of the next command
+  _commandPos = _commandLength;
+  _header->DoneSeq.store(_commandSeq);
+  Publish();
+}
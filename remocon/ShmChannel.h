@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <streambuf>
+#include <string>
+
+// Shared memory transport for remocon (Linux only), used instead of stdin/stdout when remocon is started with --shm.
+//
+// The segment (/dev/shm/<name>) starts with a ShmHeader, followed by a command area and by the output ring.
+// - The client writes one command at a time into the command area, sets CommandLength and bumps CommandSeq.
+// - Everything remocon would have written to stdout is written into the ring instead (std::cout is redirected here),
+//   and published by bumping WritePos/ServerSeq on every flush.  Positions are monotonic byte counts (offset = pos % RingSize).
+// - The client frees ring space by advancing ReadPos (and bumping ClientSeq); remocon blocks while the ring is full.
+// - Instead of the ready byte, remocon sets DoneSeq to the CommandSeq of the command it just finished.
+// Every *Seq field is a futex word; the *Waiting flags tell the other side that a wake up is needed.
+struct ShmHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint64_t CommandOffset;
+  uint64_t CommandSize;
+  uint64_t RingOffset;
+  uint64_t RingSize;
+  uint8_t Reserved[24];
+
+  // Written by the client
+  alignas(64) std::atomic<uint32_t> CommandSeq;
+  std::atomic<uint32_t> CommandLength;
+  std::atomic<uint32_t> Closed;
+  std::atomic<uint32_t> ClientWaiting;
+  alignas(64) std::atomic<uint64_t> ReadPos;
+  std::atomic<uint32_t> ClientSeq;
+
+  // Written by remocon
+  alignas(64) std::atomic<uint64_t> WritePos;
+  std::atomic<uint32_t> ServerSeq;
+  std::atomic<uint32_t> DoneSeq;
+  std::atomic<uint32_t> WriterWaiting;
+};
+
+class ShmChannel : public std::streambuf {
+private:
+  std::string _name;
+  uint8_t *_segment = nullptr;
+  size_t _segmentSize = 0;
+  ShmHeader *_header = nullptr;
+  uint8_t *_commands = nullptr;
+  uint8_t *_ring = nullptr;
+  uint64_t _ringSize = 0;
+
+  uint32_t _commandSeq = 0;
+  uint32_t _commandLength = 0;
+  uint32_t _commandPos = 0;
+  uint64_t _writePos = 0;
+  uint64_t _readPos = 0;
+  bool _closed = false;
+
+  bool WaitForCommand();
+  void WaitForSpace();
+  void Publish();
+
+protected:
+  std::streamsize xsputn(const char *data, std::streamsize count) override;
+  int overflow(int c) override;
+  int sync() override;
+
+public:
+  static const uint32_t Magic = 0x434D5252; // "RRMC"
+  static const uint32_t Version = 1;
+
+  ~ShmChannel();
+
+  bool Open(const std::string &name, uint64_t ringSize, uint64_t commandSize);
+
+  // fread-like: reads from the current command, waits for the next one once the current one was fully read.
+  // Returns 0 once the client has closed the channel.
+  size_t Read(void *buf, size_t size, size_t count);
+
+  // Marks the current command as done (replaces the ready byte), skipping any of its bytes that weren't read
+  void SendReady();
+};
@@ -0,0 +1,145 @@
+#include "StateStore.h"
+#include <iostream>
+#include <Utilities/miniz.h>
+
+void StateStore::SetMemoryCap(uint64_t bytes) {
+  _memoryCap = bytes == 0 ? UINT64_MAX : bytes;
+  EnforceMemoryCap(0);
+}
+
+void StateStore::SetCompressColdStates(bool enabled) {
+  _compressColdStates = enabled;
+}
+
+uint32_t StateStore::AddEntry(Entry &&entry) {
+  uint32_t handle = _nextHandle++;
+  while(_nextHandle == 0 || _states.count(_nextHandle)) {
+    _nextHandle++;
+  }
+  _memoryUsage += entry.Data.size();
+  std::list<uint32_t> &lru = entry.Cold ? _coldLru : _hotLru;
+  lru.push_front(handle);
+  entry.LruPosition = lru.begin();
+  _states.emplace(handle, std::move(entry));
+  EnforceMemoryCap(handle);
+  return handle;
+}
+
+uint32_t StateStore::Add(const uint8_t *state, uint32_t size) {
+  Entry entry;
+  entry.Data.assign(state, state + size);
+  entry.Size = size;
+  entry.Compressed = false;
+  entry.Cold = false;
+  return AddEntry(std::move(entry));
+}
+
+uint32_t StateStore::Clone(uint32_t handle) {
+  auto it = _states.find(handle);
+  if(it == _states.end()) {
+    return 0;
+  }
+  Touch(it->second);
+  Entry entry;
+  entry.Data = it->second.Data;
+  entry.Size = it->second.Size;
+  entry.Compressed = it->second.Compressed;
+  entry.Cold = it->second.Cold;
+  return AddEntry(std::move(entry));
+}
+
+uint8_t *StateStore::Get(uint32_t handle, uint32_t &size) {
+  auto it = _states.find(handle);
+  if(it == _states.end()) {
+    return nullptr;
+  }
+  Entry &entry = it->second;
+  Touch(entry);
+  size = entry.Size;
+  if(!entry.Compressed) {
+    return entry.Data.data();
+  }
+
+  // Stays compressed: it would most likely be compressed again soon anyway
+  _buffer.resize(entry.Size);
+  mz_ulong length = entry.Size;
+  if(mz_uncompress(_buffer.data(), &length, entry.Data.data(), (mz_ulong)entry.Data.size()) != MZ_OK || length != entry.Size) {
+    std::cerr << "Could not decompress state " << handle << "\n";
+    abort();
+  }
+  return _buffer.data();
+}
+
+bool StateStore::Drop(uint32_t handle) {
+  auto it = _states.find(handle);
+  if(it == _states.end()) {
+    return false;
+  }
+  Drop(it);
+  return true;
+}
+
+void StateStore::Drop(std::unordered_map<uint32_t, Entry>::iterator it) {
+  _memoryUsage -= it->second.Data.size();
+  (it->second.Cold ? _coldLru : _hotLru).erase(it->second.LruPosition);
+  _states.erase(it);
+}
+
+void StateStore::Touch(Entry &entry) {
+  std::list<uint32_t> &lru = entry.Cold ? _coldLru : _hotLru;
+  lru.splice(lru.begin(), lru, entry.LruPosition);
+}
+
+void StateStore::MakeCold(uint32_t handle, Entry &entry) {
+  std::vector<uint8_t> compressed(mz_compressBound(entry.Size));
+  mz_ulong length = (mz_ulong)compressed.size();
+  if(mz_compress2(compressed.data(), &length, entry.Data.data(), entry.Size, MZ_BEST_SPEED) == MZ_OK && length < entry.Size) {
+    compressed.resize(length);
+    compressed.shrink_to_fit();
+    _memoryUsage -= entry.Data.size();
+    _memoryUsage += compressed.size();
+    entry.Data = std::move(compressed);
+    entry.Compressed = true;
+  }
+  // Moved to the cold list even if it didn't compress, so we don't try again
+  _hotLru.erase(entry.LruPosition);
+  _coldLru.push_front(handle);
+  entry.LruPosition = _coldLru.begin();
+  entry.Cold = true;
+}
+
+void StateStore::EnforceMemoryCap(uint32_t keepHandle) {
+  if(_memoryUsage <= _memoryCap) {
+    return;
+  }
+
+  if(_compressColdStates) {
+    // Compress from the least recently used state, stop as soon as we are back under the cap
+    while(_memoryUsage > _memoryCap && !_hotLru.empty()) {
+      uint32_t handle = _hotLru.back();
+      MakeCold(handle, _states[handle]);
+    }
+  }
+
+  // Cold states go first.  The state that was just added is never dropped, even if it is larger than the cap on its own
+  while(_memoryUsage > _memoryCap) {
+    uint32_t handle = 0;
+    if(!_coldLru.empty() && _coldLru.back() != keepHandle) {
+      handle = _coldLru.back();
+    } else if(!_hotLru.empty() && _hotLru.back() != keepHandle) {
+      handle = _hotLru.back();
+    }
+    if(handle == 0) {
+      break;
+    }
+    Drop(_states.find(handle));
+  }
+}
+
+size_t StateStore::GetCount() {
+  return _states.size();
+}
+
+uint64_t StateStore::GetMemoryUsage() {
+  return _memoryUsage;
+}
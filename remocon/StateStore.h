@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Full states kept inside remocon and addressed by handle, so the client can branch from them (or use them as the
+// parent of a delta state) without sending them back and forth.
+// Once the states take more than the memory cap, the least recently used ones are compressed (if enabled) and then
+// dropped: a handle can disappear at any time while the store is full, Get returns nullptr for it.
+class StateStore {
+private:
+  struct Entry {
+    std::vector<uint8_t> Data;
+    uint32_t Size; // Uncompressed size
+    bool Compressed;
+    // Cold states are in _coldLru (compressed, unless they didn't compress), the others in _hotLru
+    bool Cold;
+    std::list<uint32_t>::iterator LruPosition;
+  };
+
+  std::unordered_map<uint32_t, Entry> _states;
+  // Most recently used first
+  std::list<uint32_t> _hotLru;
+  std::list<uint32_t> _coldLru;
+  uint32_t _nextHandle = 1;
+  uint64_t _memoryUsage = 0;
+  uint64_t _memoryCap = UINT64_MAX;
+  bool _compressColdStates = false;
+  // Compressed states are decompressed here by Get
+  std::vector<uint8_t> _buffer;
+
+  uint32_t AddEntry(Entry &&entry);
+  void Touch(Entry &entry);
+  void MakeCold(uint32_t handle, Entry &entry);
+  void Drop(std::unordered_map<uint32_t, Entry>::iterator it);
+  void EnforceMemoryCap(uint32_t keepHandle);
+
+public:
+  // 0 = no cap
+  void SetMemoryCap(uint64_t bytes);
+  // Compress the least recently used states before dropping any (miniz, fastest level)
+  void SetCompressColdStates(bool enabled);
+
+  // Copies the state and returns its handle (never 0)
+  uint32_t Add(const uint8_t *state, uint32_t size);
+
+  // Copies a stored state to a new handle, returns 0 if there is no such handle
+  uint32_t Clone(uint32_t handle);
+
+  // nullptr if there is no such handle.  The pointer is only valid until the next call.
+  uint8_t *Get(uint32_t handle, uint32_t &size);
+
+  // Returns false if there was no such handle
+  bool Drop(uint32_t handle);
+
+  size_t GetCount();
+  uint64_t GetMemoryUsage();
+};
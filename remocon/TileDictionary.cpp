@@ -0,0 +1,121 @@
+#include "TileDictionary.h"
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+#include <Core/HdData.h>
+
+#ifdef __linux__
+# include <fcntl.h>
+# include <sys/file.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+static_assert(sizeof(TileDictionaryHeader) == 64, "TileDictionaryHeader layout is shared with the python client");
+static_assert(sizeof(TileDictionaryEntry) == 296, "TileDictionaryEntry layout is shared with the python client");
+static_assert(offsetof(TileDictionaryEntry, Rgb) == 36, "TileDictionaryEntry layout is shared with the python client");
+
+TileDictionary::~TileDictionary() {
+#ifdef __linux__
+  if(_file) {
+    munmap(_file, _fileSize);
+  }
+#endif
+}
+
+bool TileDictionary::Open(const std::string &path, uint64_t capacity) {
+#ifdef __linux__
+  int fd = open(path.c_str(), O_CREAT | O_RDWR, 0644);
+  if(fd < 0) {
+    std::cerr << "Could not open tile dictionary " << path << "\n";
+    return false;
+  }
+  // Another remocon could be creating the same file
+  flock(fd, LOCK_EX);
+  struct stat st;
+  bool created = fstat(fd, &st) == 0 && st.st_size == 0;
+  if(created) {
+    _fileSize = sizeof(TileDictionaryHeader) + capacity * sizeof(TileDictionaryEntry);
+    if(ftruncate(fd, _fileSize) != 0) {
+      std::cerr << "Could not resize tile dictionary " << path << "\n";
+      close(fd);
+      return false;
+    }
+  } else {
+    _fileSize = st.st_size;
+  }
+
+  void *file = mmap(nullptr, _fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(file == MAP_FAILED) {
+    std::cerr << "Could not map tile dictionary " << path << "\n";
+    close(fd);
+    return false;
+  }
+  _file = (uint8_t*)file;
+  _header = (TileDictionaryHeader*)_file;
+  _entries = (TileDictionaryEntry*)(_file + sizeof(TileDictionaryHeader));
+  if(created) {
+    new (_header) TileDictionaryHeader();
+    _header->Capacity = capacity;
+    _header->Version = Version;
+    _header->Magic = Magic;
+  }
+  flock(fd, LOCK_UN);
+  close(fd);
+
+  if(_header->Magic != Magic || _header->Version != Version || _fileSize != sizeof(TileDictionaryHeader) + _header->Capacity * sizeof(TileDictionaryEntry)) {
+    std::cerr << path << " is not a tile dictionary\n";
+    munmap(_file, _fileSize);
+    _file = nullptr;
+    _header = nullptr;
+    return false;
+  }
+  return true;
+#else
+  std::cerr << "The tile dictionary is only supported on Linux\n";
+  return false;
+#endif
+}
+
+TileDictionary::AddResult TileDictionary::Add(const HdTileKey &tile, uint64_t id) {
+  uint64_t capacity = _header->Capacity;
+  bool full = _header->Count.load() >= capacity / 4 * 3;
+  for(uint64_t i = 0; i < capacity; i++) {
+    TileDictionaryEntry &entry = _entries[(id + i) % capacity];
+    uint64_t current = entry.Id.load();
+    if(current == 0) {
+      if(full) {
+        return AddResult::Full;
+      }
+      if(entry.Id.compare_exchange_strong(current, id)) {
+        entry.TileIndex = tile.TileIndex;
+        entry.PaletteColors = tile.PaletteColors;
+        memcpy(entry.TileData, tile.TileData, sizeof(entry.TileData));
+        std::vector<uint32_t> rgb = tile.ToRgb();
+        memcpy(entry.Rgb, rgb.data(), sizeof(entry.Rgb));
+        entry.Ready.store(1);
+        _header->Count.fetch_add(1);
+        return AddResult::Added;
+      }
+      // Another thread/process claimed the slot first, current is now its id
+    }
+    if(current == id) {
+      // Whoever claimed it is still writing the entry (only a few hundred ns)
+      for(uint32_t spin = 0; !entry.Ready.load(); spin++) {
+        if(spin == MaxReadySpins) {
+          return AddResult::NotReady;
+        }
+        std::this_thread::yield();
+      }
+      return AddResult::Known;
+    }
+  }
+  return AddResult::Full;
+}
+
+uint64_t TileDictionary::GetCount() {
+  return _header ? _header->Count.load() : 0;
+}
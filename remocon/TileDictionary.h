@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+struct HdTileKey;
+
+// Tiles seen by remocon, keyed by their 64-bit HdTileKey::GetContentId(), kept in a memory-mapped file (Linux only)
+// given with --tile-dict.  Every remocon using the same file (at the same time or in a later run) adds to it, so only
+// the first one to see a tile has to send it; the others only send its id and clients look the tile up in the file.
+//
+// The file is a TileDictionaryHeader followed by Capacity TileDictionaryEntry slots (open addressing: a tile goes in
+// the first free slot from id % Capacity on).  Slots are claimed by compare-and-swapping Id from 0, the rest of the
+// entry is valid once Ready is set.  Entries are never removed.
+struct TileDictionaryHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint64_t Capacity;
+  std::atomic<uint64_t> Count;
+  uint8_t Reserved[40];
+};
+
+struct TileDictionaryEntry {
+  std::atomic<uint64_t> Id;
+  std::atomic<uint32_t> Ready;
+  uint32_t TileIndex;
+  uint32_t PaletteColors;
+  uint8_t TileData[16];
+  // HdTileKey::ToRgb(), same as in the tile blobs remocon sends
+  uint32_t Rgb[8*8];
+  uint32_t Reserved;
+};
+
+class TileDictionary {
+private:
+  uint8_t *_file = nullptr;
+  size_t _fileSize = 0;
+  TileDictionaryHeader *_header = nullptr;
+  TileDictionaryEntry *_entries = nullptr;
+
+  // How long Add waits for another writer to set Ready
+  static const uint32_t MaxReadySpins = 100000;
+
+public:
+  static const uint32_t Magic = 0x54444D52; // "RMDT"
+  static const uint32_t Version = 1;
+  // Only used when creating the file (about 77MB, but sparse)
+  static const uint64_t DefaultCapacity = 1 << 18;
+
+  ~TileDictionary();
+
+  // Maps the file, creating it if needed
+  bool Open(const std::string &path, uint64_t capacity = DefaultCapacity);
+
+  enum class AddResult {
+    // Already in the dictionary (and Ready): only its id has to be sent
+    Known,
+    // This caller added it, and has to send it
+    Added,
+    // Not in the dictionary, which is 3/4 full and doesn't take new tiles anymore: the caller has to send it
+    Full,
+    // Another writer claimed the slot but didn't set Ready in time (e.g. it was killed): the caller has to send it
+    NotReady
+  };
+
+  // Safe to call from several threads and processes at once.  Known is only returned once the entry is Ready, so a
+  // client can always look up the ids it receives.
+  AddResult Add(const HdTileKey &tile, uint64_t id);
+
+  uint64_t GetCount();
+};
@@ -1,10 +1,14 @@
 import sys
+import os
 import subprocess
 import atexit
 import struct
 import io
+import mmap
+import ctypes
+import platform
 import numpy as np
-from typing import cast, Iterable, Dict, Tuple, List, Optional
+from typing import cast, Any, Callable, Iterable, Dict, Tuple, List, Optional
 from collections import namedtuple
 
 # "Framebuffers" are always 256*240*4 rgb bytes.
@@ -13,6 +17,11 @@ from collections import namedtuple
 # "TilesByPixel" is 256*240 units of int32 hash x Xscroll x Yscroll.
 # "LiveSprites" is a count C followed by C 6-byte sequences
 # (int32 hash x Xpos x Ypos).
+# "TileCells" is a count C followed by C uint16 cell indices (row * 32 + column of an 8x8 screen cell),
+# C int32 hashes, C uint8 Xscroll and C uint8 Yscroll: only the cells that changed since the last TileCells
+# (all of them after a state was loaded).
+# With a tile dictionary (tile_dict=PATH), every hash is an int64 content id instead (0 = no tile), and
+# NewTiles/NewSpriteTiles only have the tiles the dictionary didn't have yet: look the others up with TileDictionary.
 
 # enum CtrlCommand {
 CmdStep = 0  # , //Infos NumPlayers BytesPerPlayer NumMovesMSB NumMovesLSB MOVES
@@ -22,6 +31,17 @@ CmdLoadState = 2  # , //LoadState, infos, statelen, statebuf
 #                // -> loads state; if infos & FB, sends framebuffer
 CmdGetTilesSoFar = 3  # ,
 CmdGetSpriteTilesSoFar = 4
+CmdCreateInstance = 5  # , // -> instance id (uint32)
+CmdSelectInstance = 6  # , //IdLSB IdMSB
+CmdBatchStep = 7  # , //Infos NumPlayers BytesPerPlayer NumMovesLSB NumMovesMSB NumInstancesLSB NumInstancesMSB IDS MOVES
+#           // -> steps every instance in parallel, then sends each instance's Step output in order
+CmdSaveToSlot = 8  # , // -> handle (uint32)
+CmdDropSlot = 9  # , //Handle
+CmdGetStateDelta = 10  # , //ParentHandle -> delta length (0 if the slot is gone), delta
+CmdLoadStateDelta = 11  # , //Infos ParentHandle DeltaLen Delta
+#                 // -> found (uint8); loads parent + delta; if infos & FB, sends framebuffer
+CmdLoadFromSlot = 12  # , //Infos Handle -> found (uint8); if infos & FB, sends framebuffer
+CmdClone = 13  # //Handle -> new handle (uint32, 0 if the slot is gone)
 # };
 
 # enum InfoMask {
@@ -31,7 +51,7 @@ InfoNewTiles = 1 << 1
 InfoNewSpriteTiles = 1 << 2
 InfoTilesByPixel = 1 << 3
 InfoLiveSprites = 1 << 4
-InfoReservedA = 1 << 5
+InfoTileCells = 1 << 5
 InfoReservedB = 1 << 6
 InfoReservedC = 1 << 7
 
@@ -60,13 +80,19 @@ def to_uint16(num):
     return struct.pack("@H", num)
 
 
+def to_uint32(num):
+    return struct.pack("@I", num)
+
+
 Tile = namedtuple("Tile", ["hash", "index", "palette", "pixels"])
 Move = namedtuple("Move", ["A", "B", "Start", "Select", "Up", "Down", "Left", "Right"])
 Summary = namedtuple("Summary", ["new_tiles", "new_sprite_tiles"])
 PixelTileData = namedtuple("PixelTileData", ["hash", "x_scroll", "y_scroll"])
 Sprite = namedtuple("Sprite", ["hash", "horizontal_mirroring", "vertical_mirroring", "background_priority", "x", "y"])
-PerFrame = namedtuple("PerFrame", ["framebuffer", "tiles_by_pixel", "live_sprites"])
-Infos = namedtuple("Infos", ["framebuffer", "new_tiles", "new_sprite_tiles", "tiles_by_pixel", "live_sprites"])
+TileCells = namedtuple("TileCells", ["cells", "hashes", "x_scrolls", "y_scrolls"])
+PerFrame = namedtuple("PerFrame", ["framebuffer", "tiles_by_pixel", "live_sprites", "tile_cells"])
+PerFrame.__new__.__defaults__ = (None,)
+Infos = namedtuple("Infos", ["framebuffer", "new_tiles", "new_sprite_tiles", "tiles_by_pixel", "live_sprites", "tile_cells"])
 Infos.__new__.__defaults__ = (None,) * len(Infos._fields)
 
 
@@ -83,6 +109,8 @@ def infos_to_byte(infos):
         mask |= InfoTilesByPixel
     if infos.live_sprites:
         mask |= InfoLiveSprites
+    if infos.tile_cells:
+        mask |= InfoTileCells
     return mask
 
 
@@ -138,14 +166,239 @@ def moves_to_bytes(move_list):
     return list(map(move_to_byte, move_list))
 
 
+class ShmTransport(object):
+    """Client side of remocon's --shm mode; the segment layout is described in remocon/ShmChannel.h.
+
+    Stands in for both the stdin and stdout pipes: write()/flush() send one command,
+    readinto()/read_view() read its output from the ring, wait_ready() replaces the ready byte.
+
+    The header fields are read and written as single aligned machine words (ctypes), but Python
+    has no memory fences: this relies on x86-64's ordering (stores aren't reordered with other
+    stores, loads aren't reordered with other loads), which is what remocon's seq_cst atomics
+    compile to on that architecture. Other architectures would need explicit fences.
+    """
+    MAGIC = 0x434D5252
+    HEADER = struct.Struct("@IIQQQQ")
+    COMMAND_SEQ = 64
+    COMMAND_LENGTH = 68
+    CLOSED = 72
+    CLIENT_WAITING = 76
+    READ_POS = 128
+    CLIENT_SEQ = 136
+    WRITE_POS = 192
+    SERVER_SEQ = 200
+    DONE_SEQ = 204
+    WRITER_WAITING = 208
+    FUTEX_WAIT = 0
+    FUTEX_WAKE = 1
+    SYS_FUTEX = 202
+    FIELDS_U32 = (COMMAND_SEQ, COMMAND_LENGTH, CLOSED, CLIENT_WAITING, CLIENT_SEQ, SERVER_SEQ, DONE_SEQ, WRITER_WAITING)
+    FIELDS_U64 = (READ_POS, WRITE_POS)
+
+    def __init__(self, name, process):
+        # type: (str, subprocess.Popen) -> None
+        if platform.machine() not in ("x86_64", "AMD64"):
+            raise RuntimeError("the shared memory transport only supports x86-64")
+        self.process = process
+        path = "/dev/shm" + name
+        fd = os.open(path, os.O_RDWR)
+        try:
+            self.mm = mmap.mmap(fd, os.fstat(fd).st_size)
+        finally:
+            os.close(fd)
+        # Nobody else needs the name, the mapping stays valid until both sides unmap it
+        os.unlink(path)
+        magic, version, command_offset, command_size, ring_offset, ring_size = self.HEADER.unpack_from(self.mm, 0)
+        assert magic == self.MAGIC
+        self.buf = memoryview(self.mm)
+        self.commands = self.buf[command_offset:command_offset + command_size]
+        self.ring = self.buf[ring_offset:ring_offset + ring_size]
+        self.ring_size = ring_size
+        self.command = bytearray()
+        self.command_seq = 0
+        self.consumed = 0
+        # [position, length, copy] for each read_view() of the current command's output
+        self.views = []  # type: List[list]
+        self.syscall = ctypes.CDLL(None, use_errno=True).syscall
+        # One aligned ctypes word per header field, so that every load/store is a single access
+        self.fields = {}  # type: Dict[int, Any]
+        for offset in self.FIELDS_U32:
+            self.fields[offset] = ctypes.c_uint32.from_buffer(self.mm, offset)
+        for offset in self.FIELDS_U64:
+            self.fields[offset] = ctypes.c_uint64.from_buffer(self.mm, offset)
+
+    def u32(self, offset):
+        # type: (int) -> int
+        return self.fields[offset].value
+
+    def u64(self, offset):
+        # type: (int) -> int
+        return self.fields[offset].value
+
+    def set_u32(self, offset, value):
+        # type: (int, int) -> None
+        self.fields[offset].value = value & 0xFFFFFFFF
+
+    def set_u64(self, offset, value):
+        # type: (int, int) -> None
+        self.fields[offset].value = value
+
+    def futex(self, offset, op, value, timeout=None):
+        # type: (int, int, int, Optional[float]) -> None
+        ts = None
+        if timeout is not None:
+            ts = (ctypes.c_long * 2)(int(timeout), int((timeout % 1) * 1e9))
+        self.syscall(self.SYS_FUTEX, ctypes.c_void_p(ctypes.addressof(self.fields[offset])), op, value, ts, None, 0)
+
+    def write(self, data):
+        # type: (bytes) -> int
+        self.command += data
+        return len(data)
+
+    def flush(self):
+        # type: () -> None
+        """Sends the command written so far. Views of the previous command's output become invalid."""
+        if not self.command:
+            return
+        assert len(self.command) <= len(self.commands)
+        self.release()
+        self.views = []
+        self.commands[:len(self.command)] = self.command
+        self.set_u32(self.COMMAND_LENGTH, len(self.command))
+        self.command_seq = (self.command_seq + 1) & 0xFFFFFFFF
+        self.set_u32(self.COMMAND_SEQ, self.command_seq)
+        self.futex(self.COMMAND_SEQ, self.FUTEX_WAKE, 0x7FFFFFFF)
+        self.command = bytearray()
+
+    def release(self):
+        # type: () -> None
+        """Gives everything read so far back to remocon."""
+        if self.consumed == self.u64(self.READ_POS):
+            return
+        # Anything still referenced by a view is about to be overwritten
+        for view in self.views:
+            if view[2] is None:
+                offset = view[0] % self.ring_size
+                view[2] = bytes(self.ring[offset:offset + view[1]])
+        self.set_u64(self.READ_POS, self.consumed)
+        self.set_u32(self.CLIENT_SEQ, self.u32(self.CLIENT_SEQ) + 1)
+        self.futex(self.CLIENT_SEQ, self.FUTEX_WAKE, 0x7FFFFFFF)
+
+    def wait(self, done):
+        # type: (Callable[[], bool]) -> None
+        while True:
+            seq = self.u32(self.SERVER_SEQ)
+            if done():
+                return
+            if self.u32(self.WRITER_WAITING) and self.consumed != self.u64(self.READ_POS):
+                # The ring is full and remocon waits for us
+                self.release()
+                continue
+            if self.process.poll() is not None:
+                raise EOFError("remocon exited")
+            self.set_u32(self.CLIENT_WAITING, 1)
+            self.futex(self.SERVER_SEQ, self.FUTEX_WAIT, seq, 0.1)
+            self.set_u32(self.CLIENT_WAITING, 0)
+
+    def readinto(self, buf):
+        # type: (bytearray) -> int
+        target = memoryview(buf)
+        count = len(target)
+        copied = 0
+        while copied < count:
+            self.wait(lambda: self.u64(self.WRITE_POS) > self.consumed)
+            offset = self.consumed % self.ring_size
+            chunk = min(count - copied, self.u64(self.WRITE_POS) - self.consumed, self.ring_size - offset)
+            target[copied:copied + chunk] = self.ring[offset:offset + chunk]
+            copied += chunk
+            self.consumed += chunk
+        return count
+
+    def read_view(self, count):
+        # type: (int) -> list
+        """Reads count bytes without copying them when possible, pass the result to view()."""
+        offset = self.consumed % self.ring_size
+        if offset + count > self.ring_size:
+            # Wraps around the end of the ring
+            data = bytearray(count)
+            self.readinto(data)
+            return [self.consumed - count, count, data]
+        position = self.consumed
+        self.wait(lambda: self.u64(self.WRITE_POS) >= position + count)
+        self.consumed += count
+        view = [position, count, None]
+        self.views.append(view)
+        return view
+
+    def view(self, view):
+        # type: (list) -> memoryview
+        if view[2] is not None:
+            return memoryview(view[2])
+        offset = view[0] % self.ring_size
+        return self.ring[offset:offset + view[1]]
+
+    def wait_ready(self):
+        # type: () -> None
+        self.wait(lambda: self.u32(self.DONE_SEQ) == self.command_seq)
+
+    def close(self):
+        # type: () -> None
+        self.set_u32(self.CLOSED, 1)
+        self.futex(self.COMMAND_SEQ, self.FUTEX_WAKE, 0x7FFFFFFF)
+
+
+class TileDictionary(object):
+    """Read-only view of a tile dictionary file (remocon's --tile-dict), layout in remocon/TileDictionary.h.
+    Tiles added by any remocon using the file show up here as soon as they are added."""
+    MAGIC = 0x54444D52
+    HEADER = struct.Struct("@IIQQ")
+    HEADER_SIZE = 64
+    ENTRY = struct.Struct("@QIII16s")
+    ENTRY_SIZE = 296
+    RGB_OFFSET = 36
+
+    def __init__(self, path):
+        # type: (str) -> None
+        with open(path, "rb") as f:
+            self.mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, self.capacity, _ = self.HEADER.unpack_from(self.mm, 0)
+        assert magic == self.MAGIC
+
+    def __len__(self):
+        # type: () -> int
+        return self.HEADER.unpack_from(self.mm, 0)[3]
+
+    def lookup(self, tile_id):
+        # type: (int) -> Optional[Tile]
+        for i in range(self.capacity):
+            offset = self.HEADER_SIZE + ((tile_id + i) % self.capacity) * self.ENTRY_SIZE
+            entry_id, ready, index, palette, _ = self.ENTRY.unpack_from(self.mm, offset)
+            if entry_id == 0:
+                return None
+            if entry_id == tile_id:
+                if not ready:
+                    # Still being written: remocon only sends ids of ready tiles, so this is only hit when racing
+                    return None
+                start = offset + self.RGB_OFFSET
+                pixels = np.frombuffer(self.mm[start:start + 8 * 8 * 4], dtype=np.uint8).reshape((8, 8, 4))
+                return Tile(tile_id, index, palette, pixels)
+        return None
+
+
 class Mesen(object):
-    __slots__ = ("mesen", "rom", "process", "inp", "outp", "readbuf", "writebuf",
+    __slots__ = ("mesen", "rom", "process", "inp", "outp", "readbuf", "writebuf", "shm", "id_size", "id_format",
                  "num_players", "bytes_per_player", "framebuffer_length",
                  "framebuffer_height", "framebuffer_width", "framebuffer_depth")
     # TODO: type the above
 
-    def __init__(self, mesen, romfile, num_players=1, bytes_per_player=1, framebuffer_height=240, framebuffer_width=256, framebuffer_depth=4):
-        # type: (str, str, int, int, int, int, int) -> None
+    def __init__(self, mesen, romfile, num_players=1, bytes_per_player=1, framebuffer_height=240, framebuffer_width=256, framebuffer_depth=4, shm=False, ring_mb=64, slot_memory_mb=0, compress_slots=False, tile_dict=None):
+        # type: (str, str, int, int, int, int, int, bool, int, int, bool, Optional[str]) -> None
+        """With shm=True, remocon talks through a shared memory segment instead of pipes.
+        Framebuffers are then numpy views into the segment, only valid until the next command (copy them to keep them).
+        slot_memory_mb caps the memory used by saved slots (0 = no cap): past it, the least recently used slots are
+        compressed (with compress_slots=True) and then dropped.
+        With tile_dict=PATH, tile hashes are 64-bit content ids shared by every remocon using that dictionary file
+        (created if needed), and only tiles new to the dictionary are sent: see TileDictionary."""
         self.mesen = mesen
         self.rom = romfile
         self.num_players = num_players
@@ -159,7 +412,20 @@ class Mesen(object):
         assert self.framebuffer_height == 240
         assert self.framebuffer_width == 256
         assert self.framebuffer_depth == 4
-        self.process = subprocess.Popen([self.mesen, self.rom],
+        args = [self.mesen, self.rom]
+        shm_name = "/remocon-%d-%x" % (os.getpid(), id(self))
+        if shm:
+            args += ["--shm", shm_name, str(ring_mb)]
+        if slot_memory_mb:
+            args += ["--slot-memory", str(slot_memory_mb)]
+        if compress_slots:
+            args += ["--compress-slots"]
+        if tile_dict:
+            args += ["--tile-dict", tile_dict]
+        self.id_size = 8 if tile_dict else 4
+        self.id_format = "@Q" if tile_dict else "@I"
+        self.shm = None  # type: Optional[ShmTransport]
+        self.process = subprocess.Popen(args,
                                         stdin=subprocess.PIPE,
                                         stdout=subprocess.PIPE,
                                         stderr=sys.stdout,
@@ -169,29 +435,38 @@ class Mesen(object):
         self.readbuf = memoryview(bytearray([0] * 1024 * 1024 * 32))
         self.writebuf = memoryview(bytearray([0] * 1024 * 1024))
         self.wait_ready()
+        if shm:
+            # Only the first ready byte comes through stdout
+            self.shm = ShmTransport(shm_name, self.process)
+            self.inp = cast(io.BufferedWriter, self.shm)
+            self.outp = cast(io.BufferedReader, self.shm)
 
     def __del__(self):
         # type: () -> None
+        if self.shm:
+            self.shm.close()
         self.process.kill()
 
     def wait_ready(self):
         # type: () -> None
+        if self.shm:
+            self.shm.wait_ready()
+            return
         assert self.outp.readinto(cast(bytearray, self.readbuf[:1])) == 1
         assert self.readbuf[0] == 0
 
     def read_tile_sequence(self):
         # type: () -> List[Tile]
         new_tiles = []
-        print('readinto')
         assert self.outp.readinto(cast(bytearray, self.readbuf[:4])) == 4
         how_many = from_uint32(self.readbuf[0:4])
-        print("hm", how_many)
 
-        assert self.outp.readinto(cast(bytearray, self.readbuf[:(how_many * (4 + 4 + 4 + 8 * 8 * 4))])) == (how_many * (4 + 4 + 4 + 8 * 8 * 4))
+        size = how_many * (self.id_size + 4 + 4 + 8 * 8 * 4)
+        assert self.outp.readinto(cast(bytearray, self.readbuf[:size])) == size
         read_idx = 0
         for tile_idx_ in range(how_many):
-            tile_hash = from_uint32(self.readbuf[read_idx:read_idx + 4])
-            read_idx += 4
+            tile_hash = struct.unpack(self.id_format, self.readbuf[read_idx:read_idx + self.id_size])[0]
+            read_idx += self.id_size
             tile_idx = from_uint32(self.readbuf[read_idx:read_idx + 4])
             read_idx += 4
             tile_pal = from_uint32(self.readbuf[read_idx:read_idx + 4])
@@ -233,6 +508,145 @@ class Mesen(object):
                 self.writebuf[6 + i * self.num_players * self.bytes_per_player + p * self.bytes_per_player] = (moves[p][i])
         self.inp.write(cast(bytearray, self.writebuf[:6 + move_bytes]))
         self.inp.flush()
+        result = self.read_step_results(move_count, infos)
+        self.wait_ready()
+        return result
+
+    def create_instance(self):
+        # type: () -> int
+        """Starts another emulator on the same ROM, returns its id (the first one is 0)."""
+        self.writebuf[0] = CmdCreateInstance
+        self.inp.write(cast(bytearray, self.writebuf[:1]))
+        self.inp.flush()
+        assert self.outp.readinto(cast(bytearray, self.readbuf[:4])) == 4
+        instance = from_uint32(self.readbuf[:4])
+        self.wait_ready()
+        return instance
+
+    def select_instance(self, instance):
+        # type: (int) -> None
+        """Makes step and the state/tile commands apply to the given instance."""
+        self.writebuf[0] = CmdSelectInstance
+        self.writebuf[1:3] = to_uint16(instance)
+        self.inp.write(cast(bytearray, self.writebuf[:3]))
+        self.inp.flush()
+        self.wait_ready()
+
+    def save_to_slot(self):
+        # type: () -> int
+        """Keeps the current state inside remocon and returns its handle, e.g. to use it as a delta parent."""
+        self.writebuf[0] = CmdSaveToSlot
+        self.inp.write(cast(bytearray, self.writebuf[:1]))
+        self.inp.flush()
+        assert self.outp.readinto(cast(bytearray, self.readbuf[:4])) == 4
+        handle = from_uint32(self.readbuf[:4])
+        self.wait_ready()
+        return handle
+
+    def drop_slot(self, handle):
+        # type: (int) -> None
+        self.writebuf[0] = CmdDropSlot
+        self.writebuf[1:5] = to_uint32(handle)
+        self.inp.write(cast(bytearray, self.writebuf[:5]))
+        self.inp.flush()
+        self.wait_ready()
+
+    def load_from_slot(self, handle):
+        # type: (int) -> bool
+        """Loads the state saved with save_to_slot, returns False if the slot was dropped."""
+        self.writebuf[0] = CmdLoadFromSlot
+        self.writebuf[1] = InfoNone
+        self.writebuf[2:6] = to_uint32(handle)
+        self.inp.write(cast(bytearray, self.writebuf[:6]))
+        self.inp.flush()
+        assert self.outp.readinto(cast(bytearray, self.readbuf[:1])) == 1
+        found = self.readbuf[0] != 0
+        self.wait_ready()
+        return found
+
+    def clone_slot(self, handle):
+        # type: (int) -> int
+        """Copies a slot, returns the new handle (0 if the slot was dropped)."""
+        self.writebuf[0] = CmdClone
+        self.writebuf[1:5] = to_uint32(handle)
+        self.inp.write(cast(bytearray, self.writebuf[:5]))
+        self.inp.flush()
+        assert self.outp.readinto(cast(bytearray, self.readbuf[:4])) == 4
+        new_handle = from_uint32(self.readbuf[:4])
+        self.wait_ready()
+        return new_handle
+
+    def get_state_delta(self, parent):
+        # type: (int) -> Optional[bytes]
+        """Returns the current state as a delta against the state in slot parent (only the changed pages),
+        None if the slot was dropped. The picture isn't included: after loading the delta, the framebuffer
+        is the parent's until the next frame is drawn."""
+        self.writebuf[0] = CmdGetStateDelta
+        self.writebuf[1:5] = to_uint32(parent)
+        self.inp.write(cast(bytearray, self.writebuf[:5]))
+        self.inp.flush()
+        assert self.outp.readinto(cast(bytearray, self.readbuf[:4])) == 4
+        length = from_uint32(self.readbuf[:4])
+        assert self.outp.readinto(cast(bytearray, self.readbuf[:length])) == length
+        delta = bytes(self.readbuf[:length])
+        self.wait_ready()
+        return delta if length else None
+
+    def load_state_delta(self, parent, delta):
+        # type: (int, bytes) -> bool
+        """Loads a delta from get_state_delta, parent must be the slot it was made against.
+        Returns False if the slot was dropped."""
+        assert 10 + len(delta) <= len(self.writebuf)
+        self.writebuf[0] = CmdLoadStateDelta
+        self.writebuf[1] = InfoNone
+        self.writebuf[2:6] = to_uint32(parent)
+        self.writebuf[6:10] = to_uint32(len(delta))
+        self.writebuf[10:10 + len(delta)] = delta
+        self.inp.write(cast(bytearray, self.writebuf[:10 + len(delta)]))
+        self.inp.flush()
+        assert self.outp.readinto(cast(bytearray, self.readbuf[:1])) == 1
+        found = self.readbuf[0] != 0
+        self.wait_ready()
+        return found
+
+    def batch_step(self, instance_moves, infos):
+        # type: (Dict[int, Iterable[Iterable[int]]], Infos) -> Dict[int, Tuple[Iterable[PerFrame], Summary]]
+        """Steps several instances at once (in parallel on the emulator side).
+        instance_moves maps an instance id to per-player move lists, all with the same length."""
+        ids = list(instance_moves.keys())
+        all_moves = [list(map(lambda m: list(m), instance_moves[i])) for i in ids]
+        move_count = len(all_moves[0][0])
+        assert move_count < 2**16
+        assert len(ids) < 2**16
+        header = 8 + 2 * len(ids)
+        assert header + move_count * self.num_players * self.bytes_per_player * len(ids) <= len(self.writebuf)
+        self.writebuf[0] = CmdBatchStep
+        self.writebuf[1] = infos_to_byte(infos)
+        self.writebuf[2] = self.num_players
+        self.writebuf[3] = self.bytes_per_player
+        self.writebuf[4:6] = to_uint16(move_count)
+        self.writebuf[6:8] = to_uint16(len(ids))
+        for k, instance in enumerate(ids):
+            self.writebuf[8 + k * 2:10 + k * 2] = to_uint16(instance)
+        idx = header
+        for moves in all_moves:
+            assert len(moves) == self.num_players
+            for move_list in moves:
+                assert len(move_list) == move_count
+            for i in range(move_count):
+                for p in range(self.num_players):
+                    self.writebuf[idx] = moves[p][i]
+                    idx += 1
+        self.inp.write(cast(bytearray, self.writebuf[:idx]))
+        self.inp.flush()
+        results = {}
+        for instance in ids:
+            results[instance] = self.read_step_results(move_count, infos)
+        self.wait_ready()
+        return results
+
+    def read_step_results(self, move_count, infos):
+        # type: (int, Infos) -> Tuple[Iterable[PerFrame], Summary]
         # read outputs from self.outp
         per_frames = []
         read_idx = 0
@@ -240,7 +654,10 @@ class Mesen(object):
             framebuffer = None  # type: Optional[np.ndarray[int]]
             tiles_by_pixel = None  # type: Optional[List[List[PixelTileData]]]
             live_sprites = None  # type: Optional[List[Sprite]]
-            if infos.framebuffer:
+            if infos.framebuffer and self.shm:
+                # Turned into an array once the whole output is read, see below
+                framebuffer = self.shm.read_view(self.framebuffer_length)
+            elif infos.framebuffer:
                 assert self.outp.readinto(cast(bytearray, self.readbuf[:self.framebuffer_length])) == self.framebuffer_length
                 read_idx = 0
                 framebuffer = cast(np.ndarray, np.flip(np.array(self.readbuf[:self.framebuffer_length], copy=True, dtype=np.uint8).reshape((self.framebuffer_height, self.framebuffer_width, self.framebuffer_depth))[:, :, 0:3], -1))
@@ -250,12 +667,13 @@ class Mesen(object):
                 count = from_uint32(self.readbuf[:4])
 
                 rle_pixels = []
+                run_size = 4 + self.id_size + 2
                 for ii in range(count):
-                    assert self.outp.readinto(cast(bytearray, self.readbuf[:10])) == 10
+                    assert self.outp.readinto(cast(bytearray, self.readbuf[:run_size])) == run_size
                     number_of_pixels = from_uint32(self.readbuf[:4])
-                    hash = from_uint32(self.readbuf[4:8])
-                    xscroll = (self.readbuf[read_idx + 8])
-                    yscroll = (self.readbuf[read_idx + 9])
+                    hash = struct.unpack(self.id_format, self.readbuf[4:4 + self.id_size])[0]
+                    xscroll = (self.readbuf[read_idx + run_size - 2])
+                    yscroll = (self.readbuf[read_idx + run_size - 1])
                     rle_pixels.append((number_of_pixels, PixelTileData(hash, xscroll, yscroll)))
 
                 expanded: List[PixelTileData] = []
@@ -288,30 +706,42 @@ class Mesen(object):
                 assert self.outp.readinto(cast(bytearray, self.readbuf[:4])) == 4
                 how_many = from_uint32(self.readbuf[0:4])
                 if how_many != 0:
-                    assert self.outp.readinto(cast(bytearray, self.readbuf[:how_many * 7])) == how_many * 7
+                    sprite_size = self.id_size + 1 + 1 + 1
+                    assert self.outp.readinto(cast(bytearray, self.readbuf[:how_many * sprite_size])) == how_many * sprite_size
                     read_idx = 0
                     for sprite_idx in range(how_many):
-                        sprite_hash = from_uint32(self.readbuf[read_idx:read_idx + 4])
-                        sprite_flags = (self.readbuf[read_idx + 4])
+                        sprite_hash = struct.unpack(self.id_format, self.readbuf[read_idx:read_idx + self.id_size])[0]
+                        sprite_flags = (self.readbuf[read_idx + self.id_size])
                         hori = sprite_flags & (1 << 2)
                         vert = sprite_flags & (1 << 1)
                         background = sprite_flags & (1 << 0)
-                        sprite_x = (self.readbuf[read_idx + 5])
-                        sprite_y = (self.readbuf[read_idx + 6])
-                        read_idx += 4 + 1 + 1 + 1
+                        sprite_x = (self.readbuf[read_idx + self.id_size + 1])
+                        sprite_y = (self.readbuf[read_idx + self.id_size + 2])
+                        read_idx += sprite_size
                         live_sprites.append(Sprite(sprite_hash, hori, vert, background, sprite_x, sprite_y))
-            per_frames.append(PerFrame(framebuffer, tiles_by_pixel, live_sprites))
+            tile_cells = None  # type: Optional[TileCells]
+            if infos.tile_cells:
+                assert self.outp.readinto(cast(bytearray, self.readbuf[:4])) == 4
+                how_many = from_uint32(self.readbuf[0:4])
+                size = how_many * (2 + self.id_size + 1 + 1)
+                assert self.outp.readinto(cast(bytearray, self.readbuf[:size])) == size
+                data = bytes(self.readbuf[:size])
+                scrolls = how_many * (2 + self.id_size)
+                tile_cells = TileCells(np.frombuffer(data, dtype=np.uint16, count=how_many),
+                                       np.frombuffer(data, dtype=np.uint64 if self.id_size == 8 else np.uint32, count=how_many, offset=how_many * 2),
+                                       np.frombuffer(data, dtype=np.uint8, count=how_many, offset=scrolls),
+                                       np.frombuffer(data, dtype=np.uint8, count=how_many, offset=scrolls + how_many))
+            per_frames.append(PerFrame(framebuffer, tiles_by_pixel, live_sprites, tile_cells))
         # read summary statistics if infos have them
-        print("done")
         new_tiles = None  # type: Optional[List[Tile]]
         new_sprite_tiles = None  # type: Optional[List[Tile]]
         if infos.new_tiles:
             new_tiles = self.read_tile_sequence()
         if infos.new_sprite_tiles:
-            print('sprite tiles')
             new_sprite_tiles = self.read_tile_sequence()
-        print("wait")
-        self.wait_ready()
-        print("ready")
+        if infos.framebuffer and self.shm:
+            # Zero-copy views into the ring, unless the ring had to be reused while reading this output
+            per_frames = [pf._replace(framebuffer=cast(np.ndarray, np.flip(np.frombuffer(self.shm.view(pf.framebuffer), dtype=np.uint8).reshape((self.framebuffer_height, self.framebuffer_width, self.framebuffer_depth))[:, :, 0:3], -1)))
+                          for pf in per_frames]
         summary = Summary(new_tiles, new_sprite_tiles)
         return (per_frames, summary)
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cctype>
 #include <iostream>
 #include <tuple>
 
@@ -20,13 +21,47 @@
 #include <Core/IKeyManager.h>
 #include <Core/ControlManager.h>
 #include <Core/BaseControlDevice.h>
+#include <Utilities/ThreadPool.h>
+#include "ShmChannel.h"
+#include "Benchmark.h"
+#include "StateStore.h"
+#include "TileDictionary.h"
 
-uint8_t *fb[PPU::OutputBufferSize];
-stringstream saveState(stringstream::binary | stringstream::in | stringstream::out);
+// One emulator: instance 0 is the default console, the others are created with CreateInstance
+struct EmuInstance {
+  std::shared_ptr<Console> console;
+  std::shared_ptr<InstrumentingPpu> ippu;
+  DefaultVideoFilter filter;
+  uint16_t fb[PPU::PixelCount];
+  // BatchStep results are collected here by the worker threads, then sent in order
+  std::stringstream batchOutput;
+  // TileCells: what the client was last sent for each cell, only changed cells are sent again.
+  // Cleared when a state is loaded, the next TileCells then has every cell
+  static const int CellCount = (PPU::ScreenWidth / 8) * (PPU::ScreenHeight / 8);
+  bool cellsSent = false;
+  uint64_t cellHash[CellCount];
+  uint8_t cellXScroll[CellCount];
+  uint8_t cellYScroll[CellCount];
+};
+
+std::vector<std::unique_ptr<EmuInstance>> instances;
+// Set when started with --shm: commands are read from it and std::cout writes into its ring
+ShmChannel *shmChannel = nullptr;
+// Reused for every GetState, grows to the size of the largest state
+std::vector<uint8_t> stateBuffer;
+// States saved with SaveToSlot, for LoadFromSlot and as the parents of delta states
+StateStore stateStore;
+// Set when started with --tile-dict: tile ids are 64-bit content ids and only tiles new to the dictionary are sent
+TileDictionary *tileDictionary = nullptr;
 
-void SaveState() {
-  saveState.seekg(0, ios::beg);
-  Console::SaveState(saveState);
+// Saves the bound console's state into stateBuffer, returns the state's size
+uint32_t SaveState() {
+  uint32_t stateLen = Console::SaveStateTo(stateBuffer.data(), stateBuffer.size());
+  if(stateLen > stateBuffer.size()) {
+    stateBuffer.resize(stateLen);
+    Console::SaveStateTo(stateBuffer.data(), stateLen);
+  }
+  return stateLen;
 }
 
 
@@ -37,6 +72,7 @@ void RunOneFrame(uint8_t p1, uint8_t p2) {
   while(PPU::GetFrameCount() == curFrame) {
     Console::RunOneStep();
   }
+  CPU::CatchUpPpu();
   ControlManager::GetControlDevice(0)->OverrideClear();
   ControlManager::GetControlDevice(1)->OverrideClear();
 }
@@ -61,7 +97,7 @@ enum InfoMask {
   NewSpriteTiles=1<<2,
   TilesByPixel=1<<3,
   LiveSprites=1<<4,
-  ReservedA=1<<5,
+  TileCells=1<<5,
   ReservedB=1<<6,
   ReservedC=1<<7
 };
@@ -69,6 +105,13 @@ enum InfoMask {
 // "NewTiles, NewSpriteTiles, TilesSoFar, SpriteTilesSoFar" are a length L, then L 268 byte sequences (4+4+4+(8*8*4))
 // "TilesByPixel" is 256*240 units of int32 hash x Xscroll x Yscroll
 // "LiveSprites" is a count C followed by C 6-byte sequences (int32 hash x Xpos x Ypos)
+// With --tile-dict, every hash above and in TileCells is an int64 content id instead (0 = no tile, tile sequences are
+// then 272 bytes), and NewTiles, NewSpriteTiles only have the tiles that were not in the dictionary yet: the others
+// can be looked up in it by id.
+// "TileCells" only has the 8x8 screen cells whose tile (sampled at the cell's top left pixel) changed since the last
+// TileCells sent for this instance (all of them after a state was loaded): a count C, then C uint16 cell indices
+// (row*32+column), C int32 hashes, C uint8 Xscroll, C uint8 Yscroll.  Every tile row/column overlaps exactly one cell corner, so with the scroll
+// values this is the whole tile grid (as long as the scroll doesn't change inside a cell).
 
 enum CtrlCommand {
   Step=0, //Infos NumPlayers BytesPerPlayer NumMovesMSB NumMovesLSB
@@ -77,7 +120,27 @@ enum CtrlCommand {
   LoadState=2, //LoadState, infos, statelen, statebuf
                // -> loads state; if infos & FB, sends framebuffer
   GetTilesSoFar=3,
-  GetSpriteTilesSoFar=4
+  GetSpriteTilesSoFar=4,
+  CreateInstance=5, // -> instance id (uint32); the new instance starts from power-on of the same ROM
+  SelectInstance=6, //IdLSB IdMSB
+                    // -> Step, GetState, LoadState, Get*TilesSoFar now apply to this instance (0 = the first one)
+  BatchStep=7, //Infos NumPlayers BytesPerPlayer NumMovesLSB NumMovesMSB NumInstancesLSB NumInstancesMSB
+               // NumInstances * (IdLSB IdMSB), then NumInstances * (NumMoves * NumPlayers) moves
+               // -> steps all instances in parallel; sends each instance's Step output, in the order given
+  // Slots can be dropped by remocon when over the --slot-memory cap (least recently used first), the commands
+  // below report missing slots instead of failing
+  SaveToSlot=8, // -> handle (uint32); keeps the current state inside remocon
+  DropSlot=9, //Handle(uint32)
+  GetStateDelta=10, //ParentHandle(uint32)
+                    // -> delta length, delta: only the pages of the current state that differ from the parent's.  Length 0 if there is no such slot
+                    // The picture isn't part of deltas: the framebuffer of a state loaded from a delta is the parent's
+                    // (framebuffers lag a frame behind, so this is also what the first Step after loading it sends)
+  LoadStateDelta=11, //Infos ParentHandle(uint32) DeltaLen(uint32) Delta
+                     // -> found (uint8); if found, loads parent + delta and if infos & FB, sends framebuffer
+  LoadFromSlot=12, //Infos Handle(uint32)
+                   // -> found (uint8); if found, loads the slot's state and if infos & FB, sends framebuffer
+  Clone=13 //Handle(uint32)
+           // -> handle of a copy of the slot (uint32), 0 if there is no such slot
 };
 
 template<typename T> void write_seq(std::ostream &strm, const T* data, size_t count) {
@@ -90,8 +153,31 @@ template<typename T> void write_obj(std::ostream &strm, T thing) {
 
 //TODO: reader functions like the two above?
 
+// Tile ids are int64 with --tile-dict, int32 otherwise
+void write_tile_id(std::ostream &strm, uint64_t id) {
+  if(tileDictionary) {
+    write_obj(strm, id);
+  } else {
+    write_obj(strm, (uint32_t)id);
+  }
+}
+
+void write_tile_ids(std::ostream &strm, const uint64_t *ids, size_t count) {
+  if(tileDictionary) {
+    write_seq(strm, ids, count);
+  } else {
+    for(size_t i = 0; i < count; i++) {
+      write_obj(strm, (uint32_t)ids[i]);
+    }
+  }
+}
+
+uint64_t GetTileId(const HdTileKey &t) {
+  return tileDictionary ? t.GetContentId() : t.GetHashCode();
+}
+
 void BlastOneTile(HdTileKey t, std::ostream &strm) {
-  write_obj(strm, t.GetHashCode());
+  write_tile_id(strm, GetTileId(t));
   write_obj(strm, t.TileIndex);
   write_obj(strm, t.PaletteColors);
   write_seq(strm, t.ToRgb().data(), 8*8);
@@ -116,21 +202,220 @@ void BlastTiles(std::vector<HdTileKey> coll, std::ostream &strm) {
   }
 }
 
-void SendFramebuffer(std::shared_ptr<InstrumentingPpu> ippu, DefaultVideoFilter &filter, std::ostream &stream) {
-  ippu->CopyFrame((uint8_t*)fb);
-  filter.SendFrame((uint16_t*)fb);
-  FrameInfo fi = filter.GetFrameInfo();
-  uint8_t *outputBuffer = filter.GetOutputBuffer();
+// Adds the tiles to the dictionary, returns the ones it didn't have yet (all of them without --tile-dict)
+std::vector<HdTileKey> NotInDictionary(const std::vector<HdTileKey> &tiles) {
+  if(!tileDictionary) {
+    return tiles;
+  }
+  static std::atomic<bool> fullReported(false);
+  std::vector<HdTileKey> result;
+  for(const HdTileKey &t : tiles) {
+    TileDictionary::AddResult added = tileDictionary->Add(t, t.GetContentId());
+    if(added == TileDictionary::AddResult::Known) {
+      continue;
+    }
+    if(added == TileDictionary::AddResult::Full && !fullReported.exchange(true)) {
+      std::cerr << "Tile dictionary is full, tiles that aren't in it yet are sent in full from now on\n";
+    }
+    result.push_back(t);
+  }
+  return result;
+}
+
+void SendFramebuffer(EmuInstance &inst, std::ostream &stream) {
+  inst.ippu->CopyFrame((uint8_t*)inst.fb);
+  inst.filter.SendFrame(inst.fb);
+  FrameInfo fi = inst.filter.GetFrameInfo();
+  uint8_t *outputBuffer = inst.filter.GetOutputBuffer();
   size_t bufSize = fi.Width*fi.Height*fi.BitsPerPixel;
   stream.write((const char *)outputBuffer, sizeof(uint8_t)*bufSize);
   //TODO: check stream error flags??
 }
 
+void SendTileCells(EmuInstance &inst, std::ostream &stream) {
+  uint16_t cells[EmuInstance::CellCount];
+  uint64_t hashes[EmuInstance::CellCount];
+  uint8_t xScrolls[EmuInstance::CellCount];
+  uint8_t yScrolls[EmuInstance::CellCount];
+  uint32_t count = 0;
+  for(int cell = 0; cell < EmuInstance::CellCount; cell++) {
+    InstPixelData pd = inst.ippu->GetPixelData((cell / 32) * 8 * PPU::ScreenWidth + (cell % 32) * 8);
+    if(inst.cellsSent && pd.Hash == inst.cellHash[cell] && pd.XScroll == inst.cellXScroll[cell] && pd.YScroll == inst.cellYScroll[cell]) {
+      continue;
+    }
+    inst.cellHash[cell] = pd.Hash;
+    inst.cellXScroll[cell] = pd.XScroll;
+    inst.cellYScroll[cell] = pd.YScroll;
+    cells[count] = cell;
+    hashes[count] = pd.Hash;
+    xScrolls[count] = pd.XScroll;
+    yScrolls[count] = pd.YScroll;
+    count++;
+  }
+  inst.cellsSent = true;
+  write_obj(stream, count);
+  write_seq(stream, cells, count);
+  write_tile_ids(stream, hashes, count);
+  write_seq(stream, xScrolls, count);
+  write_seq(stream, yScrolls, count);
+}
+
+void StepInstance(EmuInstance &inst, InfoMask infos, uint8_t numPlayers, const uint8_t *moves, uint16_t numMoves, std::ostream &out) {
+  inst.ippu->ResetNewTiles();
+  inst.ippu->ResetNewSpriteTiles();
+  for(int i = 0; i < numMoves*numPlayers; i+=numPlayers) {
+    uint8_t p1Move = moves[i];
+    uint8_t p2Move = numPlayers == 2 ? moves[i+1] : 0;
+    //Without any output requested, only the game logic runs (but the last frame is still drawn, e.g. for GetState).
+    //Tiles aren't tracked in the skipped frames: newTiles is reset every step, they'd go in allTiles without being sent
+    PPU::SetSkipRender(infos == None && i + numPlayers < numMoves*numPlayers);
+    RunOneFrame(p1Move, p2Move);
+    //once per frame
+    if(infos & FB) {
+      SendFramebuffer(inst, out);
+    }
+    if(infos & TilesByPixel) {
+      //write tiles-by-pixel thing, int32 hashkey + int8 + int8 = 6 bytes
+
+      InstPixelData prev_pd = inst.ippu->GetPixelData(0);
+      uint32_t count = 1;
+
+      int datapoints = 0;
+      std::vector<std::tuple<uint32_t,InstPixelData> > pixels_data;
+      for(int i = 1; i < PPU::PixelCount; i++) {
+        InstPixelData pd = inst.ippu->GetPixelData(i);
+        if (pd.Hash == prev_pd.Hash &&
+            pd.XScroll == prev_pd.XScroll &&
+            pd.YScroll == prev_pd.YScroll){
+          count += 1;
+        }
+        else {
+
+          datapoints += 1;
+
+          pixels_data.push_back(std::tuple<uint32_t, InstPixelData>(count,prev_pd));
+          
+          //std::cerr <<  "{" << prev_pd.key.GetHashCode() << "," <<  prev_pd.XScroll << "," << prev_pd.YScroll << "} = " << (uint32_t) count  <<"\n";
+          prev_pd = pd;
+          count = 1;
+        }
+        
+      }
+  
+    datapoints += 1;
+
+    //std::cerr <<  "{" << prev_pd.key.GetHashCode() << "," <<  prev_pd.XScroll << "," << prev_pd.YScroll << "} = " << (uint32_t) count  <<"\n";
+          
+    pixels_data.push_back(std::tuple<uint32_t, InstPixelData>(count,prev_pd));
+    
+    write_obj(out, (uint32_t) pixels_data.size());
+    for (int i = 0; i < pixels_data.size(); ++i){
+      write_obj(out, std::get<0>(pixels_data[i]));
+      write_tile_id(out, std::get<1>(pixels_data[i]).Hash);
+      write_obj(out, std::get<1>(pixels_data[i]).XScroll);
+      write_obj(out, std::get<1>(pixels_data[i]).YScroll);
+
+    }
+    
+    //std::cerr << datapoints << " vs " <<PPU::PixelCount << " " <<PPU::PixelCount/datapoints  << " ENDTBP\n";
+    /*
+    for(int i = 0; i < PPU::PixelCount; i++) {
+        InstPixelData pd = inst.ippu->GetPixelData(i);
+        write_tile_id(out, pd.Hash);
+        write_obj(out, pd.XScroll);
+        write_obj(out, pd.YScroll);
+      }
+    */
+    }
+    
+    if(infos & LiveSprites) {
+      //TODO: update all cout << junk to use write or put as needed
+      //write sprite data, int32 hashkey + int8 + int8 + int8
+      uint32_t scount = inst.ippu->GetSpriteCount();
+      //std::cerr << "Get sprite count " << scount << "\n";
+      write_obj(out, scount);
+      for(uint32_t i = 0; i < inst.ippu->spritesThisFrame; i++) {
+        //each one is 4+1+1+1 = 7 bytes
+        InstSpriteData pd = inst.ippu->spriteData[i];
+        if(pd.key.TileIndex == HdTileKey::NoTile) {
+          continue;
+        }
+        write_tile_id(out, GetTileId(pd.key));
+        write_obj<uint8_t>(out,
+                           (pd.key.HorizontalMirroring << 2) |
+                           (pd.key.VerticalMirroring << 1) |
+                           (pd.key.BackgroundPriority << 0));
+        write_obj(out, pd.X);
+        write_obj(out, pd.Y);
+      }
+      // std::cerr << "sprites done\n";
+    }
+    if(infos & TileCells) {
+      SendTileCells(inst, out);
+    }
+    //Flush after each step so the other side can read read read
+    out.flush();
+    std::cerr.flush();
+  }
+  //once per Step call
+  if(infos & NewTiles) {
+    //blast inst.ippu->newTiles
+    BlastTiles(NotInDictionary(inst.ippu->newTiles), out);
+  }
+  if(infos & NewSpriteTiles) {
+    //blast inst.ippu->newSpriteTiles
+    BlastTiles(NotInDictionary(inst.ippu->newSpriteTiles), out);
+  }
+}
+
+// Loads the ROM into the console and instruments its PPU, returns the new instance's id
+uint16_t AddInstance(std::shared_ptr<Console> console, const std::string &romPath) {
+  if(instances.size() > UINT16_MAX) {
+    std::cerr << "Too many instances!\n";
+    abort();
+  }
+  ConsoleBinding binding(console.get());
+  Console::Pause();
+  if(!Console::LoadROM(romPath)) {
+    std::cerr << romPath+" SROM not opened!\n";
+    abort();
+  }
+  EmuInstance *inst = new EmuInstance();
+  inst->console = console;
+  inst->ippu = Console::Instrument();
+  inst->ippu->SetContentIds(tileDictionary != nullptr);
+  Console::Resume();
+  instances.emplace_back(inst);
+  return (uint16_t)(instances.size() - 1);
+}
+
 void SendReady(std::ostream &str) {
+  if(shmChannel) {
+    str.flush();
+    shmChannel->SendReady();
+    return;
+  }
   write_obj(str, (uint8_t)0);
   str.flush();
 }
 
+// fread on stdin, or on the current command when using shared memory
+size_t ReadInput(void *buf, size_t size, size_t count) {
+  if(shmChannel) {
+    return shmChannel->Read(buf, size, count);
+  }
+  return std::fread(buf, size, count, stdin);
+}
+
+uint32_t ReadHandle(const char *command) {
+  uint32_t handle;
+  if(ReadInput(&handle, sizeof(uint32_t), 1) != 1) {
+    std::cerr << "Couldn't read the handle in " << command << "\n";
+    abort();
+  }
+  return handle;
+}
+
 int main(int argc, char**argv) {
 
   //std::setvbuf(stdout,NULL,_IONBF,1024*1024*8);
@@ -141,37 +426,81 @@ int main(int argc, char**argv) {
   EmulationSettings::SetFlags(EmulationFlags::ForceMaxSpeed);
   EmulationSettings::SetControllerType(0, ControllerType::StandardController);
   EmulationSettings::SetControllerType(1, ControllerType::StandardController);
-  Console::Pause();
   if(argc < 2) {
     std::cerr << "Not enough arguments, please include a ROM file path!\n";
     abort();
   }
-  if(!Console::LoadROM(std::string(argv[1]))) {
-    std::cerr << std::string(argv[1])+" SROM not opened!\n";
-    abort();
+  std::string romPath(argv[1]);
+  // remocon ROM [--shm NAME [RING_MB]] [--slot-memory MB] [--compress-slots] [--tile-dict PATH]
+  // or remocon ROM --benchmark NAME [ITERATIONS] (see Benchmark.h)
+  ShmChannel channel;
+  TileDictionary dictionary;
+  std::string benchmark;
+  uint32_t benchmarkIterations = 10000;
+  auto nextIsNumber = [&](int i) { return i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]); };
+  for(int i = 2; i < argc; i++) {
+    std::string arg(argv[i]);
+    if(arg == "--shm" && i + 1 < argc) {
+      std::string name(argv[++i]);
+      uint64_t ringSize = (nextIsNumber(i) ? std::stoull(argv[++i]) : 64) * 1024 * 1024;
+      if(!channel.Open(name, ringSize, 1024*1024)) {
+        abort();
+      }
+      shmChannel = &channel;
+    } else if(arg == "--benchmark" && i + 1 < argc) {
+      benchmark = argv[++i];
+      if(nextIsNumber(i)) {
+        benchmarkIterations = std::stoul(argv[++i]);
+      }
+    } else if(arg == "--slot-memory" && nextIsNumber(i)) {
+      stateStore.SetMemoryCap(std::stoull(argv[++i]) * 1024 * 1024);
+    } else if(arg == "--compress-slots") {
+      stateStore.SetCompressColdStates(true);
+    } else if(arg == "--tile-dict" && i + 1 < argc) {
+      if(!dictionary.Open(argv[++i])) {
+        abort();
+      }
+      tileDictionary = &dictionary;
+    } else {
+      std::cerr << "Unknown argument: " << arg << "\n";
+      abort();
+    }
   }
-  DefaultVideoFilter filter;
-  auto ippu = Console::Instrument();
-  Console::Resume();
+  AddInstance(Console::GetInstance(), romPath);
+  if(!benchmark.empty()) {
+    bool found = RunBenchmark(benchmark, benchmarkIterations);
+    Console::Halt();
+    return found ? 0 : 1;
+  }
+  uint16_t selected = 0;
+  // Sized to the number of cores, used by BatchStep
+  ThreadPool pool;
 
   //TODO: test everything from python!
   
   uint8_t cmd_buf[1024*1024];
+  std::streambuf *stdoutBuffer = std::cout.rdbuf();
+  if(shmChannel) {
+    // The segment is ready: send the one and only ready byte on stdout, everything else goes through the segment
+    write_obj(std::cout, (uint8_t)0);
+    std::cout.flush();
+    std::cout.rdbuf(shmChannel);
+  }
   while(1) {
-    std::cerr << "Send ready\n";
     SendReady(std::cout);
-    size_t read = std::fread(cmd_buf, sizeof(uint8_t), 1, stdin);
+    size_t read = ReadInput(cmd_buf, sizeof(uint8_t), 1);
     if(read == 0) { break; }
     size_t stateLen;
     InfoMask infos=None;
     uint16_t numMoves=0;
     uint8_t numMovesLSB=0, numMovesMSB=0, bytesPerPlayer=0, numPlayers=0;
     CtrlCommand cmd = (CtrlCommand)cmd_buf[0];
+    EmuInstance &inst = *instances[selected];
+    ConsoleBinding binding(inst.console.get());
     switch(cmd) {
     case Step:
-      std::cerr << "start send\n";
       //get the next parts of the command: 
-      read = std::fread(cmd_buf, sizeof(uint8_t), 5, stdin);
+      read = ReadInput(cmd_buf, sizeof(uint8_t), 5);
       if(read != 5) {
         std::cerr << "Wrong number of bytes in Step command!\n";
         abort();
@@ -198,161 +527,233 @@ int main(int argc, char**argv) {
         std::cerr << "Too many moves, sorry!\n";
       }
       //We ought to read everything off the pipe before we can start sending our stuff.  Right??
-      read = std::fread(cmd_buf, bytesPerPlayer, numMoves*numPlayers, stdin);
+      read = ReadInput(cmd_buf, bytesPerPlayer, numMoves*numPlayers);
       if(read != numPlayers*numMoves) {
         std::cerr << "Ran out of bytes too early!\n";
         abort();
       }
-      ippu->ResetNewTiles();
-      ippu->ResetNewSpriteTiles();
-      for(int i = 0; i < numMoves*numPlayers; i+=numPlayers) {
-        uint8_t p1Move = cmd_buf[i];
-        uint8_t p2Move = numPlayers == 2 ? cmd_buf[i+1] : 0;
-        RunOneFrame(p1Move, p2Move);
-        //once per frame
-        if(infos & FB) {
-          SendFramebuffer(ippu, filter, std::cout);
-        }
-        if(infos & TilesByPixel) {
-          //write tiles-by-pixel thing, int32 hashkey + int8 + int8 = 6 bytes
-
-	  InstPixelData prev_pd = ippu->tileData[0];
-	  uint32_t count = 1;
-
-	  int datapoints = 0;
-	  std::vector<std::tuple<uint32_t,InstPixelData> > pixels_data;
-          for(int i = 1; i < PPU::PixelCount; i++) {
-	    InstPixelData pd = ippu->tileData[i];
-	    if (pd.key.GetHashCode() == prev_pd.key.GetHashCode() &&
-		pd.XScroll == prev_pd.XScroll &&
-		pd.YScroll == prev_pd.YScroll){
-	      count += 1;
-	    }
-	    else {
-
-	      datapoints += 1;
-
-	      pixels_data.push_back(std::tuple<uint32_t, InstPixelData>(count,prev_pd));
-	      
-	      //std::cerr <<  "{" << prev_pd.key.GetHashCode() << "," <<  prev_pd.XScroll << "," << prev_pd.YScroll << "} = " << (uint32_t) count  <<"\n";
-	      prev_pd = pd;
-	      count = 1;
-	    }
-	    
-	  }
-      
-	datapoints += 1;
-
-	//std::cerr <<  "{" << prev_pd.key.GetHashCode() << "," <<  prev_pd.XScroll << "," << prev_pd.YScroll << "} = " << (uint32_t) count  <<"\n";
-	      
-	pixels_data.push_back(std::tuple<uint32_t, InstPixelData>(count,prev_pd));
-	
-	write_obj(std::cout, (uint32_t) pixels_data.size());
-	for (int i = 0; i < pixels_data.size(); ++i){
-	  write_obj(std::cout, std::get<0>(pixels_data[i]));
-	  write_obj(std::cout,  std::get<1>(pixels_data[i]).key.GetHashCode());
-	  write_obj(std::cout, std::get<1>(pixels_data[i]).XScroll);
-	  write_obj(std::cout, std::get<1>(pixels_data[i]).YScroll);
-
-	}
-	
-	//std::cerr << datapoints << " vs " <<PPU::PixelCount << " " <<PPU::PixelCount/datapoints  << " ENDTBP\n";
-	/*
-	for(int i = 0; i < PPU::PixelCount; i++) {
-            InstPixelData pd = ippu->tileData[i];
-            write_obj(std::cout, pd.key.GetHashCode());
-            write_obj(std::cout, pd.XScroll);
-            write_obj(std::cout, pd.YScroll);
-          }
-	*/
-        }
-	
-        if(infos & LiveSprites) {
-          //TODO: update all cout << junk to use write or put as needed
-          //write sprite data, int32 hashkey + int8 + int8 + int8
-          uint32_t scount = ippu->GetSpriteCount();
-          //std::cerr << "Get sprite count " << scount << "\n";
-          write_obj(std::cout, scount);
-          for(int i = 0; i < ippu->spritesThisFrame; i++) {
-            //each one is 4+1+1+1 = 7 bytes
-            InstSpriteData pd = ippu->spriteData[i];
-            if(pd.key.TileIndex == HdTileKey::NoTile) {
-              continue;
-            }
-            write_obj(std::cout, pd.key.GetHashCode());
-            write_obj<uint8_t>(std::cout,
-                               (pd.key.HorizontalMirroring << 2) |
-                               (pd.key.VerticalMirroring << 1) |
-                               (pd.key.BackgroundPriority << 0));
-            write_obj(std::cout, pd.X);
-            write_obj(std::cout, pd.Y);
-          }
-          // std::cerr << "sprites done\n";
-        }
-        //Flush after each step so the other side can read read read
-        std::cout.flush();
-        std::cerr.flush();
-      }
-      //once per Step call
-      if(infos & NewTiles) {
-        //blast ippu->newTiles
-        BlastTiles(ippu->newTiles, std::cout);
-      }
-      if(infos & NewSpriteTiles) {
-        //blast ippu->newSpriteTiles
-        BlastTiles(ippu->newSpriteTiles, std::cout);
-      }
+      StepInstance(inst, infos, numPlayers, cmd_buf, numMoves, std::cout);
       break;
     case GetState:
       //GetState
-      SaveState();
-      //get file stream position
-      stateLen = saveState.tellp();
+      stateLen = SaveState();
       //write that to stdout
       write_obj(std::cout, (uint32_t) stateLen);
       //then write save state bytes
-      saveState.seekg(0, ios::beg);
-      // The one legit use we have for <<
-      std::cout << saveState.rdbuf();
-      //then reposition file stream to 0 again
-      saveState.seekg(0, ios::beg);
+      write_seq(std::cout, stateBuffer.data(), stateLen);
       break;
     case LoadState:
       //LoadState, infos, statelen, statebuf
-      read = std::fread(cmd_buf, sizeof(uint8_t), 1, stdin);
+      read = ReadInput(cmd_buf, sizeof(uint8_t), 1);
       if(read != 1) {
         std::cerr << "Couldn't read enough bytes in loadstate metadata A\n";
         abort();
       }
       infos = (InfoMask)cmd_buf[0];
-      read = std::fread(cmd_buf, sizeof(uint32_t), 1, stdin);
-      if(read != sizeof(uint32_t)) {
+      read = ReadInput(cmd_buf, sizeof(uint32_t), 1);
+      if(read != 1) {
         std::cerr << "Couldn't read enough bytes in loadstate metadata B\n";
         abort();
       }
       stateLen = *((uint32_t*)(cmd_buf));
-      read = std::fread(cmd_buf, sizeof(uint8_t), stateLen, stdin);
+      if(stateLen > sizeof(cmd_buf)) {
+        std::cerr << "State is too large!\n";
+        abort();
+      }
+      read = ReadInput(cmd_buf, sizeof(uint8_t), stateLen);
       if(read != stateLen) {
         std::cerr << "Couldn't read enough bytes in loadstate payload\n";
         abort();
       }
-      Console::LoadState(cmd_buf, stateLen);
+      if(!Console::LoadStateFrom(cmd_buf, stateLen)) {
+        std::cerr << "Incomplete state in loadstate payload\n";
+        abort();
+      }
+      inst.cellsSent = false;
       if(infos & FB) {
-        SendFramebuffer(ippu, filter, std::cout);
+        SendFramebuffer(inst, std::cout);
       }
       break;
     case GetTilesSoFar:
       //GetTilesSoFar
-      BlastTiles(ippu->allTiles, std::cout);
+      BlastTiles(inst.ippu->allTiles, std::cout);
       break;
     case GetSpriteTilesSoFar:
       //GetSpriteTilesSoFar
-      BlastTiles(ippu->allSpriteTiles, std::cout);
+      BlastTiles(inst.ippu->allSpriteTiles, std::cout);
+      break;
+    case CreateInstance:
+      write_obj(std::cout, (uint32_t)AddInstance(std::make_shared<Console>(), romPath));
+      break;
+    case SelectInstance:
+      read = ReadInput(cmd_buf, sizeof(uint8_t), 2);
+      if(read != 2) {
+        std::cerr << "Wrong number of bytes in SelectInstance command!\n";
+        abort();
+      }
+      selected = ((uint16_t)cmd_buf[1] << 8) | (uint16_t)cmd_buf[0];
+      if(selected >= instances.size()) {
+        std::cerr << "No such instance!\n";
+        abort();
+      }
+      break;
+    case BatchStep: {
+      read = ReadInput(cmd_buf, sizeof(uint8_t), 7);
+      if(read != 7) {
+        std::cerr << "Wrong number of bytes in BatchStep command!\n";
+        abort();
+      }
+      infos = (InfoMask)cmd_buf[0];
+      numPlayers = cmd_buf[1];
+      if(numPlayers > 4) {
+        std::cerr << "NES is only up to four players!\n";
+        abort();
+      }
+      bytesPerPlayer = cmd_buf[2];
+      if(bytesPerPlayer != 1) {
+        std::cerr << "NES is only one byte per player!\n";
+        abort();
+      }
+      numMoves = ((uint16_t)cmd_buf[4] << 8) | (uint16_t)cmd_buf[3];
+      if(numMoves == 0) {
+        std::cerr << "Got to give at least one move!\n";
+        abort();
+      }
+      uint16_t numInstances = ((uint16_t)cmd_buf[6] << 8) | (uint16_t)cmd_buf[5];
+      read = ReadInput(cmd_buf, sizeof(uint8_t), numInstances*2);
+      if(read != numInstances*2u) {
+        std::cerr << "Ran out of bytes too early!\n";
+        abort();
+      }
+      std::vector<uint16_t> ids(numInstances);
+      std::vector<bool> used(instances.size(), false);
+      for(int i = 0; i < numInstances; i++) {
+        ids[i] = ((uint16_t)cmd_buf[i*2+1] << 8) | (uint16_t)cmd_buf[i*2];
+        // An instance can only be stepped by one worker at a time
+        if(ids[i] >= instances.size() || used[ids[i]]) {
+          std::cerr << "Bad or repeated instance in BatchStep!\n";
+          abort();
+        }
+        used[ids[i]] = true;
+      }
+      size_t movesPerInstance = numMoves*numPlayers;
+      std::vector<uint8_t> batchMoves(movesPerInstance*numInstances);
+      read = ReadInput(batchMoves.data(), bytesPerPlayer, batchMoves.size());
+      if(read != batchMoves.size()) {
+        std::cerr << "Ran out of bytes too early!\n";
+        abort();
+      }
+      // Each worker only touches its own console. What the consoles still share is process-wide:
+      // EmulationSettings (only read while stepping, enforced below), and the video decoder, audio
+      // device, recorders and rewind data, which only the default console (instance 0) feeds.
+      EmulationSettings::SetReadOnly(true);
+      pool.ParallelFor(numInstances, [&](uint32_t i) {
+        EmuInstance &batchInst = *instances[ids[i]];
+        ConsoleBinding workerBinding(batchInst.console.get());
+        batchInst.batchOutput.str("");
+        batchInst.batchOutput.clear();
+        StepInstance(batchInst, infos, numPlayers, batchMoves.data() + i*movesPerInstance, numMoves, batchInst.batchOutput);
+      });
+      EmulationSettings::SetReadOnly(false);
+      for(int i = 0; i < numInstances; i++) {
+        EmuInstance &batchInst = *instances[ids[i]];
+        const std::string &output = batchInst.batchOutput.str();
+        std::cout.write(output.data(), output.size());
+        batchInst.batchOutput.str("");
+      }
+      break;
+    }
+    case SaveToSlot:
+      stateLen = SaveState();
+      write_obj(std::cout, stateStore.Add(stateBuffer.data(), stateLen));
+      break;
+    case DropSlot:
+      stateStore.Drop(ReadHandle("DropSlot"));
+      break;
+    case GetStateDelta: {
+      uint32_t parentLen = 0;
+      uint8_t *parent = stateStore.Get(ReadHandle("GetStateDelta"), parentLen);
+      stateLen = 0;
+      if(parent) {
+        stateLen = Console::SaveStateDelta(parent, parentLen, stateBuffer.data(), stateBuffer.size());
+        if(stateLen > stateBuffer.size()) {
+          stateBuffer.resize(stateLen);
+          Console::SaveStateDelta(parent, parentLen, stateBuffer.data(), stateLen);
+        }
+      }
+      write_obj(std::cout, (uint32_t) stateLen);
+      write_seq(std::cout, stateBuffer.data(), stateLen);
+      break;
+    }
+    case LoadStateDelta: {
+      read = ReadInput(cmd_buf, sizeof(uint8_t), 1);
+      if(read != 1) {
+        std::cerr << "Couldn't read enough bytes in loadstatedelta metadata A\n";
+        abort();
+      }
+      infos = (InfoMask)cmd_buf[0];
+      uint32_t parentLen = 0;
+      uint8_t *parent = stateStore.Get(ReadHandle("LoadStateDelta"), parentLen);
+      read = ReadInput(cmd_buf, sizeof(uint32_t), 1);
+      if(read != 1) {
+        std::cerr << "Couldn't read enough bytes in loadstatedelta metadata B\n";
+        abort();
+      }
+      stateLen = *((uint32_t*)(cmd_buf));
+      if(stateLen > sizeof(cmd_buf)) {
+        std::cerr << "Delta is too large!\n";
+        abort();
+      }
+      read = ReadInput(cmd_buf, sizeof(uint8_t), stateLen);
+      if(read != stateLen) {
+        std::cerr << "Couldn't read enough bytes in loadstatedelta payload\n";
+        abort();
+      }
+      write_obj(std::cout, (uint8_t)(parent != nullptr));
+      if(!parent) {
+        break;
+      }
+      if(!Console::LoadStateDelta(parent, parentLen, cmd_buf, stateLen)) {
+        std::cerr << "Delta doesn't match its parent state\n";
+        abort();
+      }
+      inst.cellsSent = false;
+      if(infos & FB) {
+        SendFramebuffer(inst, std::cout);
+      }
+      break;
+    }
+    case LoadFromSlot: {
+      read = ReadInput(cmd_buf, sizeof(uint8_t), 1);
+      if(read != 1) {
+        std::cerr << "Couldn't read enough bytes in loadfromslot metadata\n";
+        abort();
+      }
+      infos = (InfoMask)cmd_buf[0];
+      uint32_t slotLen = 0;
+      uint8_t *state = stateStore.Get(ReadHandle("LoadFromSlot"), slotLen);
+      write_obj(std::cout, (uint8_t)(state != nullptr));
+      if(!state) {
+        break;
+      }
+      if(!Console::LoadStateFrom(state, slotLen)) {
+        std::cerr << "Incomplete state in slot\n";
+        abort();
+      }
+      inst.cellsSent = false;
+      if(infos & FB) {
+        SendFramebuffer(inst, std::cout);
+      }
+      break;
+    }
+    case Clone:
+      write_obj(std::cout, stateStore.Clone(ReadHandle("Clone")));
       break;
     default:
       break;
     }
   }
+  std::cout.rdbuf(stdoutBuffer);
   Console::Halt();
   return 0;
 }